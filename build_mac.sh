@@ -5,4 +5,4 @@ make PLATFORM=PLATFORM_DESKTOP
 popd
 
 echo "Building chip8 emulator..."
-gcc main.c -o chip8 -I deps/raylib/src -L deps/raylib/src -lraylib -framework CoreGraphics -framework IOKit -framework Cocoa
\ No newline at end of file
+gcc main.c trace.c overlay.c pacing.c chip8.c savestate.c rewind.c fork.c statehash.c movie.c coverage.c debugger.c timetravel.c input.c buzzer.c wav.c romdb.c -o chip8 -I deps/raylib/src -L deps/raylib/src -lraylib -framework CoreGraphics -framework IOKit -framework Cocoa
\ No newline at end of file
@@ -1,6 +1,6 @@
-emcc -o index.html main.c -Os -Wall deps/libs/libraylib.a \
+emcc -o index.html main.c trace.c overlay.c pacing.c chip8.c savestate.c rewind.c fork.c statehash.c movie.c coverage.c debugger.c timetravel.c input.c buzzer.c wav.c romdb.c -Os -Wall deps/libs/libraylib.a \
     -I. -Ideps/raylib/src -L. -Ldeps/raylib/src -s USE_GLFW=3 \
-    -DPLATFORM_WEB --embed-file roms/morse_demo.ch8 --embed-file beep-02.wav \
+    -DPLATFORM_WEB --embed-file roms/morse_demo.ch8 \
     -s TOTAL_MEMORY=67108864 \
     -s FORCE_FILESYSTEM=1 -s ASSERTIONS=1 --profiling \
     -s ALLOW_MEMORY_GROWTH=1 \
@@ -0,0 +1,90 @@
+#include <math.h>
+
+#include "buzzer.h"
+
+void buzzer_init(Buzzer *buzzer, uint32_t sample_rate)
+{
+    buzzer->sample_rate = sample_rate;
+    buzzer->position = 0;
+    buzzer->starved_samples = 0;
+
+    for (uint32_t pitch = 0; pitch < 256; pitch++)
+    {
+        double bits_per_second = 4000.0 * pow(2.0, ((double)pitch - 64.0) / 48.0);
+        buzzer->steps[pitch] = (uint32_t)(bits_per_second / sample_rate * (1U << BUZZER_POSITION_FRACTION_BITS));
+    }
+
+    atomic_store(&buzzer->samples_left, 0);
+    atomic_store(&buzzer->step, buzzer->steps[CHIP8_DEFAULT_PITCH]);
+    atomic_store(&buzzer->pattern[0], 0);
+    atomic_store(&buzzer->pattern[1], 0);
+    atomic_store(&buzzer->sounding, false);
+    atomic_store(&buzzer->underruns, 0);
+}
+
+void buzzer_update(Buzzer *buzzer, const Chip8 *chip8)
+{
+    // Bit 0 of the pattern is the MSB of its first byte
+    uint64_t pattern[2] = { 0, 0 };
+    for (size_t i = 0; i < CHIP8_AUDIO_PATTERN_SIZE; i++)
+    {
+        pattern[i / 8] = (pattern[i / 8] << 8) | chip8->audio_pattern[i];
+    }
+
+    atomic_store(&buzzer->pattern[0], pattern[0]);
+    atomic_store(&buzzer->pattern[1], pattern[1]);
+    atomic_store(&buzzer->step, buzzer->steps[chip8->pitch]);
+    atomic_store(&buzzer->samples_left, (uint32_t)chip8->sound_timer * buzzer->sample_rate / EMULATION_HZ);
+    atomic_store(&buzzer->sounding, chip8->sound_timer > 0);
+}
+
+void buzzer_silence(Buzzer *buzzer)
+{
+    atomic_store(&buzzer->samples_left, 0);
+    atomic_store(&buzzer->sounding, false);
+}
+
+void buzzer_render(Buzzer *buzzer, int16_t *out, size_t frames)
+{
+    uint32_t samples_left = atomic_load(&buzzer->samples_left);
+    uint32_t step = atomic_load(&buzzer->step);
+    uint64_t pattern[2] = { atomic_load(&buzzer->pattern[0]), atomic_load(&buzzer->pattern[1]) };
+    size_t tone = frames < samples_left ? frames : samples_left;
+
+    uint32_t position = buzzer->position;
+    for (size_t i = 0; i < tone; i++)
+    {
+        uint32_t bit = position >> BUZZER_POSITION_FRACTION_BITS;
+        bool high = (pattern[bit >> 6] >> (63 - (bit & 63))) & 1;
+        out[i] = high ? BUZZER_AMPLITUDE : -BUZZER_AMPLITUDE;
+        position += step;
+    }
+    for (size_t i = tone; i < frames; i++)
+    {
+        out[i] = 0;
+    }
+    // Restart each beep at the start of the pattern
+    buzzer->position = tone < frames ? 0 : position;
+
+    // A tone that ends on time stays published until the emulator's next update, so
+    // only silence lasting more than a tick counts as starving, once per gap
+    uint32_t tick_samples = buzzer->sample_rate / EMULATION_HZ;
+    if (tone == frames || !atomic_load(&buzzer->sounding))
+    {
+        buzzer->starved_samples = 0;
+    }
+    else if (buzzer->starved_samples <= tick_samples)
+    {
+        buzzer->starved_samples += frames - tone;
+        if (buzzer->starved_samples > tick_samples)
+            atomic_fetch_add(&buzzer->underruns, 1);
+    }
+
+    // If the emulator published a new timer meanwhile, that one wins
+    atomic_compare_exchange_strong(&buzzer->samples_left, &samples_left, samples_left - (uint32_t)tone);
+}
+
+size_t buzzer_tick_samples(const Buzzer *buzzer, uint64_t tick)
+{
+    return (tick + 1) * buzzer->sample_rate / EMULATION_HZ - tick * buzzer->sample_rate / EMULATION_HZ;
+}
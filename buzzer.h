@@ -0,0 +1,63 @@
+#ifndef BUZZER_H
+#define BUZZER_H
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "chip8.h"
+#include "pacing.h"
+
+// Sound timer output. It only produces samples, so the same generator serves an
+// audio device callback and offline rendering. The emulator publishes how long
+// the timer has left together with the XO-CHIP pattern and pitch, the audio side
+// counts the timer down one sample at a time so the tone ends on the sample the
+// timer expires on rather than at the next frame.
+//
+// The pattern is 128 one-bit samples played in a loop. The read position is a
+// 32 bit fixed point number, 7 integer bits pick the pattern bit and the other
+// 25 are the fraction, so stepping it is one add per sample
+
+#define BUZZER_SAMPLE_RATE (44100U)
+#define BUZZER_AMPLITUDE (6000)
+#define BUZZER_DEFAULT_BUFFER_FRAMES (512U)
+
+#define BUZZER_PATTERN_BITS (CHIP8_AUDIO_PATTERN_SIZE * 8)
+#define BUZZER_POSITION_FRACTION_BITS (25U)
+
+typedef struct
+{
+    uint32_t sample_rate;
+    // Position step per output sample for every pitch, worked out once up front
+    uint32_t steps[256];
+    // Only touched by the audio side
+    uint32_t position;
+    uint32_t starved_samples;
+    // Written by the emulator thread, read by the audio thread
+    _Atomic uint32_t samples_left;
+    _Atomic uint32_t step;
+    _Atomic uint64_t pattern[2];
+    _Atomic bool sounding;
+    // Written by the audio thread: times the tone ran dry for longer than a tick while
+    // the emulator still had the sound timer running, it fell behind the audio device
+    _Atomic uint64_t underruns;
+} Buzzer;
+
+void buzzer_init(Buzzer *buzzer, uint32_t sample_rate);
+
+// Call after emulated ticks, picks up the sound timer, pattern and pitch
+void buzzer_update(Buzzer *buzzer, const Chip8 *chip8);
+
+// Stops the tone, e.g. while the machine is not running forwards
+void buzzer_silence(Buzzer *buzzer);
+
+// Fills frames mono samples, safe to call from the audio thread
+void buzzer_render(Buzzer *buzzer, int16_t *out, size_t frames);
+
+// Samples that fall into emulated tick number tick, so rendering tick by tick
+// against emulated time never drifts from sample_rate samples per second
+#define BUZZER_MAX_TICK_SAMPLES(sample_rate) ((sample_rate) / EMULATION_HZ + 1)
+size_t buzzer_tick_samples(const Buzzer *buzzer, uint64_t tick);
+
+#endif
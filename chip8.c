@@ -0,0 +1,396 @@
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "chip8.h"
+
+const uint8_t hex_sprites[80] = {
+    0xF0, 0x90, 0x90, 0x90, 0xF0, // 0
+    0x20, 0x60, 0x20, 0x20, 0x70, // 1
+    0xF0, 0x10, 0xF0, 0x80, 0xF0, // 2
+    0xF0, 0x10, 0xF0, 0x10, 0xF0, // 3
+    0x90, 0x90, 0xF0, 0x10, 0x10, // 4
+    0xF0, 0x80, 0xF0, 0x10, 0xF0, // 5
+    0xF0, 0x80, 0xF0, 0x90, 0xF0, // 6
+    0xF0, 0x10, 0x20, 0x40, 0x40, // 7
+    0xF0, 0x90, 0xF0, 0x90, 0xF0, // 8
+    0xF0, 0x90, 0xF0, 0x10, 0xF0, // 9
+    0xF0, 0x90, 0xF0, 0x90, 0x90, // A
+    0xE0, 0x90, 0xE0, 0x90, 0xE0, // B
+    0xF0, 0x80, 0x80, 0x80, 0xF0, // C
+    0xE0, 0x90, 0x90, 0x90, 0xE0, // D
+    0xF0, 0x80, 0xF0, 0x80, 0xF0, // E
+    0xF0, 0x80, 0xF0, 0x80, 0x80, // F
+};
+
+const uint8_t big_hex_sprites[160] = {
+    0xFF, 0xFF, 0xC3, 0xC3, 0xC3, 0xC3, 0xC3, 0xC3, 0xFF, 0xFF, // 0
+    0x18, 0x78, 0x78, 0x18, 0x18, 0x18, 0x18, 0x18, 0xFF, 0xFF, // 1
+    0xFF, 0xFF, 0x03, 0x03, 0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF, // 2
+    0xFF, 0xFF, 0x03, 0x03, 0xFF, 0xFF, 0x03, 0x03, 0xFF, 0xFF, // 3
+    0xC3, 0xC3, 0xC3, 0xC3, 0xFF, 0xFF, 0x03, 0x03, 0x03, 0x03, // 4
+    0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF, 0x03, 0x03, 0xFF, 0xFF, // 5
+    0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF, 0xC3, 0xC3, 0xFF, 0xFF, // 6
+    0xFF, 0xFF, 0x03, 0x03, 0x06, 0x0C, 0x18, 0x18, 0x18, 0x18, // 7
+    0xFF, 0xFF, 0xC3, 0xC3, 0xFF, 0xFF, 0xC3, 0xC3, 0xFF, 0xFF, // 8
+    0xFF, 0xFF, 0xC3, 0xC3, 0xFF, 0xFF, 0x03, 0x03, 0xFF, 0xFF, // 9
+    // SUPER-CHIP only had digits, A-F are the ones Octo added
+    0x7E, 0xFF, 0xC3, 0xC3, 0xC3, 0xFF, 0xFF, 0xC3, 0xC3, 0xC3, // A
+    0xFC, 0xFC, 0xC3, 0xC3, 0xFC, 0xFC, 0xC3, 0xC3, 0xFC, 0xFC, // B
+    0x3C, 0xFF, 0xC3, 0xC0, 0xC0, 0xC0, 0xC0, 0xC3, 0xFF, 0x3C, // C
+    0xFC, 0xFE, 0xC3, 0xC3, 0xC3, 0xC3, 0xC3, 0xC3, 0xFE, 0xFC, // D
+    0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF, // E
+    0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF, 0xC0, 0xC0, 0xC0, 0xC0, // F
+};
+
+void stack_push(Stack* stack, uint16_t val)
+{
+    /* if (stack->stack_pointer + 1 > CHIP8_STACK_SIZE) */
+    /* { */
+    /*     DEBUG_PRINT("WARNING: STACK OVERFLOW\n"); */
+    /*     return; */
+    /* } */
+
+    stack->stack_arr[stack->stack_pointer] = val;
+    stack->stack_pointer++;
+}
+
+uint16_t stack_pop(Stack* stack)
+{
+    /* if (stack->stack_pointer == 0) */
+    /* { */
+    /*     DEBUG_PRINT("WARNING: popping from empty stack\n"); */
+    /*     return 0; */
+    /* } */
+
+    stack->stack_pointer--;
+    uint16_t val = stack->stack_arr[stack->stack_pointer];
+
+    return val;
+}
+
+const char *chip8_status_name(Chip8Status status)
+{
+    switch (status)
+    {
+    case CHIP8_OK:
+        return "ok";
+    case CHIP8_TRAP_INVALID_OPCODE:
+        return "invalid opcode";
+    case CHIP8_TRAP_STACK_OVERFLOW:
+        return "stack overflow";
+    case CHIP8_TRAP_STACK_UNDERFLOW:
+        return "stack underflow";
+    case CHIP8_BREAKPOINT:
+        return "breakpoint";
+    case CHIP8_WATCHPOINT:
+        return "watchpoint";
+    }
+    return "unknown";
+}
+
+bool is_instruction(uint16_t opcode, uint16_t instruction)
+{
+    return (opcode & instruction);
+}
+
+void chip8_init(Chip8 *chip8, uint32_t seed)
+{
+    memset(chip8, 0, sizeof(*chip8));
+    memcpy(chip8->memory, hex_sprites, sizeof(hex_sprites));
+    chip8->program_counter = CHIP8_PROGRAM_START;
+    chip8->display_dirty = true;
+    // xorshift32 never leaves zero, so that seed is not allowed
+    chip8->rng_state = seed ? seed : CHIP8_DEFAULT_SEED;
+    memset(chip8->audio_pattern, CHIP8_DEFAULT_AUDIO_PATTERN_BYTE, sizeof(chip8->audio_pattern));
+    chip8->pitch = CHIP8_DEFAULT_PITCH;
+    chip8->planes = 1;
+    chip8->address_mask = CHIP8_CLASSIC_MEMORY_SIZE - 1;
+}
+
+void chip8_free(Chip8 *chip8)
+{
+    free(chip8->extended_memory);
+    chip8->extended_memory = NULL;
+}
+
+static uint8_t *allocate_extended_memory(void)
+{
+    uint8_t *memory = malloc(CHIP8_MEMORY_SIZE);
+    if (memory == NULL)
+    {
+        fprintf(stderr, "ERROR: out of memory for XO-CHIP memory\n");
+        exit(1);
+    }
+    return memory;
+}
+
+void chip8_copy(Chip8 *to, const Chip8 *from)
+{
+    uint8_t *extended_memory = to->extended_memory;
+    if (from->extended_memory == NULL)
+    {
+        free(extended_memory);
+        extended_memory = NULL;
+    }
+    else if (extended_memory == NULL)
+    {
+        extended_memory = allocate_extended_memory();
+    }
+
+    *to = *from;
+    to->extended_memory = extended_memory;
+    if (extended_memory != NULL)
+        memcpy(extended_memory, from->extended_memory, CHIP8_MEMORY_SIZE);
+}
+
+void chip8_resize_memory(Chip8 *chip8, size_t size)
+{
+    if (size > CHIP8_CLASSIC_MEMORY_SIZE && chip8->extended_memory == NULL)
+    {
+        chip8->extended_memory = allocate_extended_memory();
+        memcpy(chip8->extended_memory, chip8->memory, CHIP8_CLASSIC_MEMORY_SIZE);
+        memset(chip8->extended_memory + CHIP8_CLASSIC_MEMORY_SIZE, 0, CHIP8_MEMORY_SIZE - CHIP8_CLASSIC_MEMORY_SIZE);
+    }
+    else if (size <= CHIP8_CLASSIC_MEMORY_SIZE && chip8->extended_memory != NULL)
+    {
+        memcpy(chip8->memory, chip8->extended_memory, CHIP8_CLASSIC_MEMORY_SIZE);
+        chip8_free(chip8);
+    }
+    chip8->address_mask = size - 1;
+}
+
+void chip8_set_platform(Chip8 *chip8, Chip8Platform platform)
+{
+    chip8->platform = platform;
+    chip8_resize_memory(chip8, chip8_platform_memory_size(platform));
+    // Plain CHIP-8 keeps the memory it always had, so its hashes and save states don't change
+    if (platform != CHIP8_PLATFORM_CHIP8)
+        memcpy(CHIP8_MEMORY(chip8) + CHIP8_BIG_FONT_START, big_hex_sprites, sizeof(big_hex_sprites));
+}
+
+static const char *platform_names[] = {
+    [CHIP8_PLATFORM_CHIP8] = "chip8",
+    [CHIP8_PLATFORM_SCHIP] = "schip",
+    [CHIP8_PLATFORM_XOCHIP] = "xochip",
+};
+
+const char *chip8_platform_name(Chip8Platform platform)
+{
+    return (size_t)platform < ARRAY_SIZE(platform_names) ? platform_names[platform] : "unknown";
+}
+
+bool chip8_parse_platform(const char *name, Chip8Platform *platform)
+{
+    for (size_t i = 0; i < ARRAY_SIZE(platform_names); i++)
+    {
+        if (strcmp(name, platform_names[i]) == 0)
+        {
+            *platform = (Chip8Platform)i;
+            return true;
+        }
+    }
+    return false;
+}
+
+void chip8_set_quirks(Chip8 *chip8, uint8_t quirks)
+{
+    chip8->quirks = quirks;
+}
+
+static const struct
+{
+    const char *name;
+    uint8_t quirks;
+} quirk_profiles[] = {
+    { "none", 0 },
+    // The COSMAC VIP interpreter
+    { "vip", CHIP8_QUIRK_SHIFT_VY | CHIP8_QUIRK_MEMORY_INCREMENT_I | CHIP8_QUIRK_VF_RESET
+             | CHIP8_QUIRK_CLIP | CHIP8_QUIRK_DISPLAY_WAIT },
+    // SUPER-CHIP 1.1 on the HP48
+    { "schip", CHIP8_QUIRK_JUMP_VX | CHIP8_QUIRK_CLIP },
+    // Octo
+    { "xochip", CHIP8_QUIRK_SHIFT_VY | CHIP8_QUIRK_MEMORY_INCREMENT_I },
+};
+
+bool chip8_parse_quirks(const char *name, uint8_t *quirks)
+{
+    for (size_t i = 0; i < ARRAY_SIZE(quirk_profiles); i++)
+    {
+        if (strcmp(name, quirk_profiles[i].name) == 0)
+        {
+            *quirks = quirk_profiles[i].quirks;
+            return true;
+        }
+    }
+    return false;
+}
+
+const char *chip8_quirks_name(uint8_t quirks)
+{
+    for (size_t i = 0; i < ARRAY_SIZE(quirk_profiles); i++)
+    {
+        if (quirk_profiles[i].quirks == quirks)
+            return quirk_profiles[i].name;
+    }
+    return NULL;
+}
+
+uint8_t chip8_random_next(uint32_t *rng_state)
+{
+    uint32_t x = *rng_state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    *rng_state = x;
+    return (uint8_t)(x >> 24);
+}
+
+uint8_t chip8_random(Chip8 *chip8)
+{
+    return chip8_random_next(&chip8->rng_state);
+}
+
+bool chip8_program_fits(const Chip8 *chip8, size_t size)
+{
+    if (size > chip8_memory_size(chip8) - CHIP8_PROGRAM_START)
+    {
+        fprintf(stderr, "Program is %zu bytes, at most %zu fit in %s memory\n",
+                size, chip8_memory_size(chip8) - CHIP8_PROGRAM_START, chip8_platform_name(chip8->platform));
+        return false;
+    }
+    return true;
+}
+
+bool chip8_load_program(Chip8 *chip8, const uint8_t *program, size_t size)
+{
+    if (!chip8_program_fits(chip8, size))
+        return false;
+
+    memcpy(CHIP8_MEMORY(chip8) + CHIP8_PROGRAM_START, program, size);
+    chip8->program_counter = CHIP8_PROGRAM_START;
+    return true;
+}
+
+// Reads until buffer holds capacity bytes or the file ends, *size counts what is there
+static bool read_up_to(int fd, uint8_t *buffer, size_t capacity, size_t *size)
+{
+    while (*size < capacity)
+    {
+        ssize_t count = read(fd, buffer + *size, capacity - *size);
+        if (count < 0 && errno == EINTR)
+            continue;
+        if (count < 0)
+        {
+            fprintf(stderr, "Could not read program: %s\n", strerror(errno));
+            return false;
+        }
+        if (count == 0)
+            break;
+        *size += count;
+    }
+    return true;
+}
+
+bool chip8_read_program(Chip8 *chip8, int fd, size_t *size)
+{
+    size_t classic_capacity = CHIP8_CLASSIC_MEMORY_SIZE - CHIP8_PROGRAM_START;
+    size_t capacity = CHIP8_MEMORY_SIZE - CHIP8_PROGRAM_START;
+
+    *size = 0;
+    if (!read_up_to(fd, CHIP8_MEMORY(chip8) + CHIP8_PROGRAM_START, classic_capacity, size))
+        return false;
+
+    // Only a program that goes on past classic memory gets the XO-CHIP block
+    uint8_t next;
+    size_t next_size = 0;
+    if (*size == classic_capacity && chip8->extended_memory == NULL)
+    {
+        if (!read_up_to(fd, &next, 1, &next_size))
+            return false;
+        if (next_size > 0)
+        {
+            chip8_resize_memory(chip8, CHIP8_MEMORY_SIZE);
+            CHIP8_MEMORY(chip8)[CHIP8_PROGRAM_START + (*size)++] = next;
+        }
+    }
+    if (chip8->extended_memory != NULL
+        && !read_up_to(fd, CHIP8_MEMORY(chip8) + CHIP8_PROGRAM_START, capacity, size))
+        return false;
+
+    // A full address space is only fine when the file ends right there
+    next_size = 0;
+    if (*size == capacity && !read_up_to(fd, &next, 1, &next_size))
+        return false;
+    if (next_size > 0)
+    {
+        fprintf(stderr, "Program is larger than the %zu bytes of any platform's memory\n", capacity);
+        return false;
+    }
+
+    chip8->program_counter = CHIP8_PROGRAM_START;
+    return true;
+}
+
+uint16_t chip8_fetch(const Chip8 *chip8)
+{
+    // Opcodes are stored big endian
+    return ((uint16_t)CHIP8_MEMORY(chip8)[chip8->program_counter & chip8->address_mask] << 8)
+           | CHIP8_MEMORY(chip8)[(chip8->program_counter + 1) & chip8->address_mask];
+}
+
+void dump_display_memory(const Chip8 *chip8)
+{
+    DEBUG_PRINT("Display Memory");
+	for (uint32_t y = 0; y < CHIP8_HIRES_HEIGHT; y++)
+    {
+        for (uint32_t plane = 0; plane < CHIP8_PLANE_COUNT; plane++)
+        {
+            for (uint32_t word = 0; word < CHIP8_DISPLAY_WORDS; word++)
+            {
+                DEBUG_PRINT("%016llx ", (unsigned long long)chip8->display[plane][y][word]);
+            }
+        }
+        DEBUG_PRINT("\n");
+    }
+}
+
+#define CHIP8_EXECUTE execute_instruction
+#define CHIP8_MACHINE Chip8
+#define MEM_READ(m, addr) (CHIP8_MEMORY(m)[(addr) & (m)->address_mask])
+#define MEM_WRITE(m, addr, value) (CHIP8_MEMORY(m)[(addr) & (m)->address_mask] = (value))
+#define DISPLAY(m) ((m)->display)
+#define DISPLAY_WRITE_BEGIN(m)
+#define CHIP8_SPECIALIZE_QUIRKS
+#include "chip8_execute.inc"
+
+Chip8Status chip8_step(Chip8 *chip8)
+{
+    Chip8Status status = execute_instruction(chip8, chip8_fetch(chip8));
+    DEBUG_PRINT("\n");
+    return status;
+}
+
+void chip8_tick_timers(Chip8 *chip8)
+{
+    if (chip8->delay_timer > 0)
+        chip8->delay_timer--;
+
+    if (chip8->sound_timer > 0)
+        chip8->sound_timer--;
+
+    if (chip8->quirks & CHIP8_QUIRK_DISPLAY_WAIT)
+        chip8->vblank = true;
+}
+
+uint16_t create_draw_instruction(uint8_t vx, uint8_t vy, uint8_t n)
+{
+	uint16_t opcode = 0xD000;
+	uint16_t X = (vx << 8) & 0x0F00;
+	uint16_t Y = (vy << 4) & 0x00F0;
+	uint16_t N = n & 0x000F;
+	return opcode | X | Y | N;
+}
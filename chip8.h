@@ -0,0 +1,336 @@
+#ifndef CHIP8_H
+#define CHIP8_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+// #define DEBUG
+
+// TODO error logging as well
+#ifdef DEBUG
+#define DEBUG_PRINT printf
+#else
+#define DEBUG_PRINT
+#endif
+
+#define ARRAY_SIZE(arr) (sizeof(arr)/sizeof(arr[0]))
+
+// The XO-CHIP address space, CHIP-8 and SUPER-CHIP only have the first 4 KB. Guest
+// addresses wrap around at the end of the platform's memory, see address_mask
+#define CHIP8_MEMORY_SIZE 65536U
+#define CHIP8_CLASSIC_MEMORY_SIZE 4096U
+#define CHIP8_STACK_SIZE 16U
+#define CHIP8_KEY_COUNT 16
+#define CHIP8_PROGRAM_START (0x200)
+#define CHIP8_DEFAULT_SEED (1U)
+
+#define CLEAR_SCREEN             (0x00E0)
+#define RETURN_SUBROUTINE        (0x00EE)
+#define JUMP_ADDR                (0x1000)
+#define CALL                     (0x2000)
+#define SKIP_IF_EQ_IMM           (0x3000)
+#define SKIP_IF_NEQ_IMM          (0x4000)
+#define SKIP_IF_EQ               (0x5000)
+#define ASSIGN_VX_IMM            (0x6000)
+#define ADD_VX_IMM               (0x7000)
+#define ASSIGN_VX_VY             (0x8000)
+#define OR_VX_VY                 (0x8001)
+#define AND_VX_VY                (0x8002)
+#define XOR_VX_VY                (0x8003)
+#define ADD_VX_VY                (0x8004)
+#define SUB_VX_VY                (0x8005)
+#define RIGHT_SHIFT_VX_VY        (0x8006)
+#define VX_SUB_VY                (0x8007)
+#define LEFT_SHIFT_VX_VY         (0x800E)
+#define SKIP_IF_NEQ              (0x9000)
+#define SET_I_ADDR               (0xA000)
+#define JUMP_PLUS_V0             (0xB000)
+#define RAND                     (0xC000)
+#define DRAW_SPRITE              (0xD000)
+#define SKIP_IF_KEY_PRESSED      (0xE09E)
+#define SKIP_IF_KEY_NOT_PRESSED  (0xE0A1)
+#define SET_VX_TIMER             (0xF007)
+#define KEY_AWAIT_STORE          (0xF00A)
+#define SET_DELAY_TIMER          (0xF015)
+#define SET_SOUND_TIMER          (0xF018)
+#define ADD_I_VX                 (0xF01E)
+#define SET_I_SPRITE_LOCATION    (0xF029)
+#define SET_BCD_VX               (0xF033)
+#define REG_DUMP                 (0xF055)
+#define REG_LOAD                 (0xF065)
+// XO-CHIP audio
+#define LOAD_AUDIO_PATTERN       (0xF002)
+#define SET_PITCH_VX             (0xF03A)
+// SUPER-CHIP 1.1
+#define SCROLL_DOWN              (0x00C0)
+#define SCROLL_RIGHT             (0x00FB)
+#define SCROLL_LEFT              (0x00FC)
+#define LOW_RESOLUTION           (0x00FE)
+#define HIGH_RESOLUTION          (0x00FF)
+#define SET_I_BIG_SPRITE         (0xF030)
+#define SAVE_FLAGS               (0xF075)
+#define LOAD_FLAGS               (0xF085)
+// XO-CHIP
+#define SCROLL_UP                (0x00D0)
+#define SAVE_RANGE               (0x5002)
+#define LOAD_RANGE               (0x5003)
+#define SET_I_LONG               (0xF000)
+#define SELECT_PLANES            (0xF001)
+
+#define INSTRUCTION_SIZE (2)
+
+#define CHIP8_AUDIO_PATTERN_SIZE (16U)
+// Plays the pattern at 4000 bits per second
+#define CHIP8_DEFAULT_PITCH (64U)
+// Every byte of the power-on pattern, a 500 Hz square wave at the default pitch
+#define CHIP8_DEFAULT_AUDIO_PATTERN_BYTE (0xF0)
+
+// Low resolution, the only one plain CHIP-8 has
+#define WIDTH (64U)
+#define HEIGHT (32U)
+#define CHIP8_HIRES_WIDTH (128U)
+#define CHIP8_HIRES_HEIGHT (64U)
+
+// Every display row is packed into 64 bit words, the MSB of word 0 is the leftmost
+// pixel. Low resolution only uses word 0 of the first HEIGHT rows
+#define CHIP8_DISPLAY_WORDS (CHIP8_HIRES_WIDTH / 64)
+typedef uint64_t Chip8Plane[CHIP8_HIRES_HEIGHT][CHIP8_DISPLAY_WORDS];
+
+// XO-CHIP draws on two bitplanes, a pixel's color is plane 0's bit plus twice plane 1's.
+// Everything else only ever selects plane 0
+#define CHIP8_PLANE_COUNT (2U)
+#define CHIP8_ALL_PLANES ((1U << CHIP8_PLANE_COUNT) - 1)
+typedef Chip8Plane Chip8Display[CHIP8_PLANE_COUNT];
+
+#define CHIP8_FLAG_REGISTER_COUNT (16U)
+// The SUPER-CHIP 8x10 digits, right after the small font
+#define CHIP8_BIG_FONT_START (0x50)
+
+// Each platform runs everything the ones before it do
+typedef enum
+{
+    CHIP8_PLATFORM_CHIP8,
+    CHIP8_PLATFORM_SCHIP,
+    CHIP8_PLATFORM_XOCHIP,
+    CHIP8_PLATFORM_COUNT,
+} Chip8Platform;
+
+// Behaviors the CHIP-8 interpreters disagree on, none set is how this one always behaved
+typedef enum
+{
+    // 8XY6/8XYE shift VY into VX instead of shifting VX in place
+    CHIP8_QUIRK_SHIFT_VY = 1 << 0,
+    // FX55/FX65 leave I pointing past the last register
+    CHIP8_QUIRK_MEMORY_INCREMENT_I = 1 << 1,
+    // BNNN jumps to XNN + VX instead of NNN + V0
+    CHIP8_QUIRK_JUMP_VX = 1 << 2,
+    // 8XY1/8XY2/8XY3 clear VF
+    CHIP8_QUIRK_VF_RESET = 1 << 3,
+    // DXYN drops sprite pixels past the right and bottom edges instead of wrapping them
+    CHIP8_QUIRK_CLIP = 1 << 4,
+    // DXYN waits for the next timer tick, so a program draws at most once per frame
+    CHIP8_QUIRK_DISPLAY_WAIT = 1 << 5,
+} Chip8Quirk;
+
+#define CHIP8_QUIRK_COMBINATIONS (1U << 6)
+
+// X(n) for every quirk combination n, to instantiate an engine specialized for each
+#define CHIP8_FOR_EACH_QUIRKS(X)                                                          \
+    X(0)  X(1)  X(2)  X(3)  X(4)  X(5)  X(6)  X(7)  X(8)  X(9)  X(10) X(11) X(12)       \
+    X(13) X(14) X(15) X(16) X(17) X(18) X(19) X(20) X(21) X(22) X(23) X(24) X(25)      \
+    X(26) X(27) X(28) X(29) X(30) X(31) X(32) X(33) X(34) X(35) X(36) X(37) X(38)      \
+    X(39) X(40) X(41) X(42) X(43) X(44) X(45) X(46) X(47) X(48) X(49) X(50) X(51)      \
+    X(52) X(53) X(54) X(55) X(56) X(57) X(58) X(59) X(60) X(61) X(62) X(63)
+
+extern const uint8_t hex_sprites[80];
+extern const uint8_t big_hex_sprites[160];
+
+typedef struct
+{
+    uint16_t stack_arr[CHIP8_STACK_SIZE];
+    uint8_t stack_pointer;
+} Stack;
+
+typedef union
+{
+    uint8_t V[16];
+    struct
+    {
+        uint8_t V0;
+        uint8_t V1;
+        uint8_t V2;
+        uint8_t V3;
+        uint8_t V4;
+        uint8_t V5;
+        uint8_t V6;
+        uint8_t V7;
+        uint8_t V8;
+        uint8_t V9;
+        uint8_t VA;
+        uint8_t VB;
+        uint8_t VC;
+        uint8_t VD;
+        uint8_t VE;
+        uint8_t VF;
+    };
+} Registers;
+
+// Everything the machine is made of lives in here. Only XO-CHIP memory is allocated
+// separately, so the other platforms don't drag 64 KB through every snapshot. A
+// machine owns that block: copy machines with chip8_copy rather than by assignment,
+// into a machine that is initialized or zeroed, and give it back with chip8_free
+typedef struct
+{
+    // CHIP-8 and SUPER-CHIP memory, unused on XO-CHIP. Go through CHIP8_MEMORY
+    uint8_t memory[CHIP8_CLASSIC_MEMORY_SIZE];
+    Registers registers;
+    uint16_t I;
+    Stack stack;
+    uint16_t program_counter;
+    uint16_t delay_timer;
+    uint16_t sound_timer;
+    Chip8Display display;
+    bool hires;
+    // XO-CHIP FN01, bit n set when plane n is drawn on, cleared and scrolled
+    uint8_t planes;
+    // Set whenever display changes so the frontend only re-uploads the texture when needed
+    bool display_dirty;
+    // Bit n is set while chip8 key n is held
+    uint16_t keypad;
+    // xorshift32 state behind CXNN, part of the machine so replays are deterministic
+    uint32_t rng_state;
+    // XO-CHIP sound: a 128 bit waveform played while the sound timer runs, at a rate set by pitch
+    uint8_t audio_pattern[CHIP8_AUDIO_PATTERN_SIZE];
+    uint8_t pitch;
+    // SUPER-CHIP FX75/FX85 storage, the HP48 RPL user flags
+    uint8_t rpl[CHIP8_FLAG_REGISTER_COUNT];
+    // Fixed for the life of the machine, instructions of other platforms trap
+    Chip8Platform platform;
+    // Memory size of the platform minus one
+    uint16_t address_mask;
+    // Chip8Quirk bits, fixed for the life of the machine like the platform
+    uint8_t quirks;
+    // Set by a timer tick and taken by DXYN, only with CHIP8_QUIRK_DISPLAY_WAIT
+    bool vblank;
+    // Rolling hashes of memory and display, see statehash.h
+    uint64_t memory_hash;
+    uint64_t display_hash;
+    // All CHIP8_MEMORY_SIZE bytes of XO-CHIP memory, NULL on the other platforms
+    uint8_t *extended_memory;
+} Chip8;
+
+// Base of the machine's memory, const for a const machine
+#define CHIP8_MEMORY(m) ((m)->extended_memory != NULL ? (m)->extended_memory : (m)->memory)
+
+typedef enum
+{
+    CHIP8_OK,
+    CHIP8_TRAP_INVALID_OPCODE,
+    CHIP8_TRAP_STACK_OVERFLOW,
+    CHIP8_TRAP_STACK_UNDERFLOW,
+    // Only returned by chip8_step_debug
+    CHIP8_BREAKPOINT,
+    CHIP8_WATCHPOINT,
+} Chip8Status;
+
+const char *chip8_status_name(Chip8Status status);
+
+void stack_push(Stack* stack, uint16_t val);
+uint16_t stack_pop(Stack* stack);
+bool is_instruction(uint16_t opcode, uint16_t instruction);
+
+// Clears the machine, loads the font and seeds the random number generator. Takes
+// uninitialized storage, a machine still owning XO-CHIP memory has to be freed first
+void chip8_init(Chip8 *chip8, uint32_t seed);
+// Releases the machine's XO-CHIP memory, if it has any
+void chip8_free(Chip8 *chip8);
+// Deep copy. The destination reuses its own XO-CHIP block, allocating one only when it has none
+void chip8_copy(Chip8 *to, const Chip8 *from);
+uint8_t chip8_random(Chip8 *chip8);
+// Advances an xorshift32 state and returns the next byte, for machine layouts other than Chip8
+uint8_t chip8_random_next(uint32_t *rng_state);
+
+// Enables the instructions of platform and loads its font, call right after chip8_init
+void chip8_set_platform(Chip8 *chip8, Chip8Platform platform);
+// Gives the machine size bytes of memory (CHIP8_CLASSIC_MEMORY_SIZE or CHIP8_MEMORY_SIZE)
+// and sets address_mask to match. What fits of the current contents is kept
+void chip8_resize_memory(Chip8 *chip8, size_t size);
+const char *chip8_platform_name(Chip8Platform platform);
+// CHIP8_PLATFORM_* matching name, false when there is none
+bool chip8_parse_platform(const char *name, Chip8Platform *platform);
+
+// Call right after chip8_init, the default is no quirks
+void chip8_set_quirks(Chip8 *chip8, uint8_t quirks);
+// Quirks of a named profile (none, vip, schip, xochip), false when there is none
+bool chip8_parse_quirks(const char *name, uint8_t *quirks);
+// Profile name of a quirk set, NULL when it isn't one of the profiles
+const char *chip8_quirks_name(uint8_t quirks);
+
+static inline bool chip8_display_pixel(const Chip8Plane plane, uint32_t x, uint32_t y)
+{
+    return (plane[y][x / 64] >> (63 - x % 64)) & 1;
+}
+
+static inline size_t chip8_platform_memory_size(Chip8Platform platform)
+{
+    return platform == CHIP8_PLATFORM_XOCHIP ? CHIP8_MEMORY_SIZE : CHIP8_CLASSIC_MEMORY_SIZE;
+}
+
+static inline size_t chip8_memory_size(const Chip8 *chip8)
+{
+    return (size_t)chip8->address_mask + 1;
+}
+
+// Moves a sprite row, left aligned in bits, to column x of a display row. Pixels
+// past the right edge wrap around to the left, in high resolution across both words,
+// or are dropped when clip is set
+static inline void chip8_sprite_row(uint64_t bits, uint32_t x, bool hires, bool clip, uint64_t row[CHIP8_DISPLAY_WORDS])
+{
+    if (!hires)
+    {
+        row[0] = x ? bits >> x | (clip ? 0 : bits << (64 - x)) : bits;
+        row[1] = 0;
+    }
+    else if (x < 64)
+    {
+        row[0] = bits >> x;
+        row[1] = x ? bits << (64 - x) : 0;
+    }
+    else
+    {
+        row[0] = x > 64 && !clip ? bits << (128 - x) : 0;
+        row[1] = bits >> (x - 64);
+    }
+}
+
+// Copies a program to CHIP8_PROGRAM_START, false when it does not fit the platform's memory
+bool chip8_load_program(Chip8 *chip8, const uint8_t *program, size_t size);
+// Reports programs that don't fit the platform's memory, for chip8_read_program
+bool chip8_program_fits(const Chip8 *chip8, size_t size);
+// Reads a program from fd straight into memory at CHIP8_PROGRAM_START until the end
+// of the file, no intermediate buffer. Only the address space limits it, so the
+// platform can still be picked from the program's bytes: check chip8_program_fits
+// once it is set
+bool chip8_read_program(Chip8 *chip8, int fd, size_t *size);
+
+uint16_t chip8_fetch(const Chip8 *chip8);
+Chip8Status execute_instruction(Chip8 *chip8, uint16_t opcode);
+Chip8Status chip8_step(Chip8 *chip8);
+void chip8_tick_timers(Chip8 *chip8);
+
+static inline void chip8_snapshot(const Chip8 *chip8, Chip8 *snapshot)
+{
+    chip8_copy(snapshot, chip8);
+}
+
+static inline void chip8_restore(Chip8 *chip8, const Chip8 *snapshot)
+{
+    chip8_copy(chip8, snapshot);
+}
+
+void dump_display_memory(const Chip8 *chip8);
+uint16_t create_draw_instruction(uint8_t vx, uint8_t vy, uint8_t n);
+
+#endif
@@ -7,6 +7,22 @@ const char *target = "chip8_emulator";
 
 const char *files[] = {
     "main.c",
+    "trace.c",
+    "overlay.c",
+    "pacing.c",
+    "chip8.c",
+    "savestate.c",
+    "rewind.c",
+    "fork.c",
+    "statehash.c",
+    "movie.c",
+    "coverage.c",
+    "debugger.c",
+    "timetravel.c",
+    "input.c",
+    "buzzer.c",
+    "wav.c",
+    "romdb.c",
     NULL,
 };
 
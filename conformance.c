@@ -0,0 +1,186 @@
+#include <pthread.h>
+#include <string.h>
+
+#include "conformance.h"
+#include "host_time.h"
+#include "statehash.h"
+
+// Taps 1, then holds F so the golden shows a highlighted key
+static const ConformanceInput keypad_test_script[] = {
+    { .frame = 30, .keypad = 1U << 0x1 },
+    { .frame = 40, .keypad = 0 },
+    { .frame = 60, .keypad = 1U << 0xF },
+};
+
+const ConformanceCase conformance_cases[] = {
+    { .rom = "1-chip8-logo.ch8" },
+    { .rom = "2-IBM-LOGO.ch8" },
+    { .rom = "3-corax+.ch8" },
+    { .rom = "4-flags.ch8" },
+    { .rom = "chip8-test-rom.ch8" },
+    { .rom = "keypad_test.ch8", .script = keypad_test_script, .script_length = ARRAY_SIZE(keypad_test_script) },
+};
+
+const size_t conformance_case_count = ARRAY_SIZE(conformance_cases);
+
+bool conformance_run_case(const ConformanceCase *test, const char *rom_dir, ConformanceResult *result)
+{
+    memset(result, 0, sizeof(*result));
+
+    char path[512];
+    snprintf(path, sizeof(path), "%s/%s", rom_dir, test->rom);
+    FILE *file = fopen(path, "rb");
+    if (file == NULL)
+    {
+        fprintf(stderr, "Could not open %s\n", path);
+        return false;
+    }
+
+    uint8_t rom[CHIP8_MEMORY_SIZE - CHIP8_PROGRAM_START];
+    size_t rom_size = fread(rom, 1, sizeof(rom), file);
+    fclose(file);
+
+    Chip8 machine;
+    Chip8 *chip8 = &machine;
+    chip8_init(chip8, CHIP8_DEFAULT_SEED);
+    if (!chip8_load_program(chip8, rom, rom_size))
+        return false;
+
+    Chip8Display previous_display;
+    memcpy(previous_display, chip8->display, sizeof(previous_display));
+
+    // The screen only counts as settled once the script has played out
+    uint32_t script_end = test->script_length > 0 ? test->script[test->script_length - 1].frame : 0;
+    uint32_t unchanged_frames = 0;
+    size_t next_input = 0;
+
+    uint64_t start_ns = host_time_ns();
+    for (result->frames = 0; result->frames < CONFORMANCE_MAX_FRAMES; result->frames++)
+    {
+        while (next_input < test->script_length && test->script[next_input].frame <= result->frames)
+        {
+            chip8->keypad = test->script[next_input++].keypad;
+        }
+
+        chip8_tick_timers(chip8);
+        for (uint32_t step = 0; step < CONFORMANCE_INSTRUCTIONS_PER_FRAME; step++)
+        {
+            result->status = chip8_step(chip8);
+            if (result->status != CHIP8_OK)
+                break;
+        }
+        if (result->status != CHIP8_OK)
+            break;
+
+        if (memcmp(previous_display, chip8->display, sizeof(previous_display)) != 0)
+        {
+            memcpy(previous_display, chip8->display, sizeof(previous_display));
+            unchanged_frames = 0;
+        }
+        else if (result->frames >= script_end && ++unchanged_frames >= CONFORMANCE_STABLE_FRAMES)
+        {
+            result->stable = true;
+            result->frames++;
+            break;
+        }
+    }
+    result->elapsed_ns = host_time_ns() - start_ns;
+
+    result->display_hash = statehash_display(chip8->display);
+    result->ran = true;
+    return true;
+}
+
+typedef struct
+{
+    const ConformanceCase *test;
+    const char *rom_dir;
+    ConformanceResult result;
+} ConformanceJob;
+
+static void *conformance_worker(void *arg)
+{
+    ConformanceJob *job = arg;
+    conformance_run_case(job->test, job->rom_dir, &job->result);
+    return NULL;
+}
+
+static bool find_golden(FILE *goldens, const char *rom, uint64_t *hash)
+{
+    char name[256];
+    unsigned long long value;
+
+    rewind(goldens);
+    while (fscanf(goldens, "%255s %llx", name, &value) == 2)
+    {
+        if (strcmp(name, rom) == 0)
+        {
+            *hash = value;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool conformance_run_suite(const char *rom_dir, const char *golden_path, bool update, FILE *out)
+{
+    ConformanceJob jobs[ARRAY_SIZE(conformance_cases)];
+    pthread_t threads[ARRAY_SIZE(conformance_cases)];
+
+    uint64_t start_ns = host_time_ns();
+    for (size_t i = 0; i < conformance_case_count; i++)
+    {
+        jobs[i] = (ConformanceJob){ .test = &conformance_cases[i], .rom_dir = rom_dir };
+        pthread_create(&threads[i], NULL, conformance_worker, &jobs[i]);
+    }
+    for (size_t i = 0; i < conformance_case_count; i++)
+    {
+        pthread_join(threads[i], NULL);
+    }
+    uint64_t elapsed_ns = host_time_ns() - start_ns;
+
+    FILE *goldens = fopen(golden_path, update ? "w" : "r");
+    if (goldens == NULL)
+    {
+        fprintf(stderr, "Could not open goldens %s\n", golden_path);
+        return false;
+    }
+
+    size_t passed = 0;
+    for (size_t i = 0; i < conformance_case_count; i++)
+    {
+        const ConformanceJob *job = &jobs[i];
+        const ConformanceResult *result = &job->result;
+
+        const char *verdict;
+        uint64_t golden = 0;
+        if (!result->ran)
+            verdict = "ERROR";
+        else if (result->status != CHIP8_OK)
+            verdict = chip8_status_name(result->status);
+        else if (!result->stable)
+            verdict = "UNSTABLE";
+        else if (update)
+        {
+            fprintf(goldens, "%s %016llx\n", job->test->rom, (unsigned long long)result->display_hash);
+            verdict = "UPDATED";
+            passed++;
+        }
+        else if (!find_golden(goldens, job->test->rom, &golden))
+            verdict = "NO GOLDEN";
+        else if (golden != result->display_hash)
+            verdict = "FAIL";
+        else
+        {
+            verdict = "ok";
+            passed++;
+        }
+
+        fprintf(out, "%-10s %-20s %016llx  %4u frames  %6.2f ms\n", verdict, job->test->rom,
+                (unsigned long long)result->display_hash, result->frames, result->elapsed_ns / 1e6);
+    }
+
+    bool ok = (fclose(goldens) == 0) && passed == conformance_case_count;
+    fprintf(out, "%zu/%zu passed in %.2f ms\n", passed, conformance_case_count, elapsed_ns / 1e6);
+    return ok;
+}
@@ -0,0 +1,58 @@
+#ifndef CONFORMANCE_H
+#define CONFORMANCE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "chip8.h"
+
+// Golden-image conformance suite over the bundled test ROMs. Each ROM runs headless
+// with its scripted input until the screen has not changed for
+// CONFORMANCE_STABLE_FRAMES, then the framebuffer hash is compared against the
+// golden recorded in CONFORMANCE_GOLDEN_FILE. All ROMs run in parallel.
+//
+// Goldens are "<rom> <hash>" lines, regenerate them with chip8-headless conformance --update
+// after a deliberate change to what a ROM shows
+
+#define CONFORMANCE_GOLDEN_FILE "roms/conformance.golden"
+#define CONFORMANCE_INSTRUCTIONS_PER_FRAME (20U)
+#define CONFORMANCE_STABLE_FRAMES (60U)
+#define CONFORMANCE_MAX_FRAMES (1200U)
+
+typedef struct
+{
+    // Keypad from this frame until the next entry
+    uint32_t frame;
+    uint16_t keypad;
+} ConformanceInput;
+
+typedef struct
+{
+    const char *rom;
+    const ConformanceInput *script;
+    size_t script_length;
+} ConformanceCase;
+
+extern const ConformanceCase conformance_cases[];
+extern const size_t conformance_case_count;
+
+typedef struct
+{
+    bool ran;
+    bool stable;
+    Chip8Status status;
+    uint32_t frames;
+    uint64_t display_hash;
+    uint64_t elapsed_ns;
+} ConformanceResult;
+
+// Runs one case from rom_dir, false when the ROM could not be loaded
+bool conformance_run_case(const ConformanceCase *test, const char *rom_dir, ConformanceResult *result);
+
+// Runs every case in parallel and checks (or with update, rewrites) the goldens.
+// Returns true when every ROM reached a stable screen matching its golden
+bool conformance_run_suite(const char *rom_dir, const char *golden_path, bool update, FILE *out);
+
+#endif
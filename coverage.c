@@ -0,0 +1,176 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "coverage.h"
+
+static const struct
+{
+    uint8_t flag;
+    const char *name;
+} coverage_names[] = {
+    { COVERAGE_EXECUTED, "code" },
+    { COVERAGE_OPERAND, "operand" },
+    { COVERAGE_SPRITE, "sprite" },
+    { COVERAGE_READ, "read" },
+    { COVERAGE_WRITTEN, "written" },
+};
+
+// Map being recorded into and how the current instruction's reads count, set by
+// chip8_step_coverage around each instruction
+static _Thread_local CoverageMap *recording_map;
+static _Thread_local uint8_t read_flag;
+
+void coverage_reset(CoverageMap *map)
+{
+    memset(map, 0, sizeof(*map));
+}
+
+static inline uint8_t coverage_read(Chip8 *chip8, uint16_t address)
+{
+    address &= chip8->address_mask;
+    recording_map->flags[address] |= read_flag;
+    return CHIP8_MEMORY(chip8)[address];
+}
+
+static inline void coverage_write(Chip8 *chip8, uint16_t address, uint8_t value)
+{
+    address &= chip8->address_mask;
+    recording_map->flags[address] |= COVERAGE_WRITTEN;
+    CHIP8_MEMORY(chip8)[address] = value;
+}
+
+#define CHIP8_EXECUTE execute_instruction_coverage
+#define CHIP8_MACHINE Chip8
+#define MEM_READ(m, addr) coverage_read((m), (addr))
+#define MEM_WRITE(m, addr, value) coverage_write((m), (addr), (value))
+#define CODE_READ(m, addr) (CHIP8_MEMORY(m)[(addr) & (m)->address_mask])
+#define DISPLAY(m) ((m)->display)
+#define DISPLAY_WRITE_BEGIN(m)
+#include "chip8_execute.inc"
+
+uint8_t coverage_record_instruction(CoverageMap *map, const Chip8 *chip8, uint16_t opcode)
+{
+    map->flags[chip8->program_counter & chip8->address_mask] |= COVERAGE_EXECUTED;
+    map->flags[(chip8->program_counter + 1) & chip8->address_mask] |= COVERAGE_OPERAND;
+    if (opcode == SET_I_LONG && chip8->platform == CHIP8_PLATFORM_XOCHIP)
+    {
+        map->flags[(chip8->program_counter + 2) & chip8->address_mask] |= COVERAGE_OPERAND;
+        map->flags[(chip8->program_counter + 3) & chip8->address_mask] |= COVERAGE_OPERAND;
+    }
+
+    // Only DXYN and FX65 read guest memory
+    return (opcode & 0xF000) == 0xD000 ? COVERAGE_SPRITE : COVERAGE_READ;
+}
+
+Chip8Status chip8_step_coverage(Chip8 *chip8, CoverageMap *map)
+{
+    uint16_t opcode = chip8_fetch(chip8);
+    recording_map = map;
+    read_flag = coverage_record_instruction(map, chip8, opcode);
+    return execute_instruction_coverage(chip8, opcode);
+}
+
+static void write_flags(FILE *file, uint8_t flags)
+{
+    const char *separator = "";
+    for (size_t i = 0; i < ARRAY_SIZE(coverage_names); i++)
+    {
+        if (flags & coverage_names[i].flag)
+        {
+            fprintf(file, "%s%s", separator, coverage_names[i].name);
+            separator = "+";
+        }
+    }
+}
+
+// Both bytes of an instruction are exported as code, otherwise every instruction
+// would split the listing into two lines
+static uint8_t export_flags(uint8_t flags)
+{
+    return (flags & COVERAGE_OPERAND) ? (flags & ~COVERAGE_OPERAND) | COVERAGE_EXECUTED : flags;
+}
+
+bool coverage_save_file(const CoverageMap *map, const char *rom_name, size_t rom_size, const char *path)
+{
+    FILE *file = fopen(path, "w");
+    if (file == NULL)
+    {
+        fprintf(stderr, "Could not open coverage map %s for writing\n", path);
+        return false;
+    }
+
+    fprintf(file, "# chip8 code/data map of %s (%zu bytes at 0x%03x)\n", rom_name, rom_size, CHIP8_PROGRAM_START);
+
+    size_t address = 0;
+    while (address < CHIP8_MEMORY_SIZE)
+    {
+        uint8_t flags = export_flags(map->flags[address]);
+        size_t end = address + 1;
+        while (end < CHIP8_MEMORY_SIZE && export_flags(map->flags[end]) == flags)
+            end++;
+
+        if (flags != 0)
+        {
+            fprintf(file, "%04zx-%04zx ", address, end - 1);
+            write_flags(file, flags);
+            fprintf(file, "\n");
+        }
+        address = end;
+    }
+
+    bool ok = fclose(file) == 0;
+    if (!ok)
+        fprintf(stderr, "Could not write coverage map %s\n", path);
+    return ok;
+}
+
+bool coverage_load_file(CoverageMap *map, const char *path)
+{
+    FILE *file = fopen(path, "r");
+    if (file == NULL)
+    {
+        fprintf(stderr, "Could not open coverage map %s\n", path);
+        return false;
+    }
+
+    coverage_reset(map);
+
+    char line[256];
+    bool ok = true;
+    while (ok && fgets(line, sizeof(line), file) != NULL)
+    {
+        if (line[0] == '#' || line[0] == '\n')
+            continue;
+
+        unsigned int first, last;
+        char names[128];
+        if (sscanf(line, "%x-%x %127s", &first, &last, names) != 3
+            || first > last || last >= CHIP8_MEMORY_SIZE)
+        {
+            ok = false;
+            break;
+        }
+
+        uint8_t flags = 0;
+        for (char *name = strtok(names, "+"); name != NULL; name = strtok(NULL, "+"))
+        {
+            size_t i = 0;
+            while (i < ARRAY_SIZE(coverage_names) && strcmp(coverage_names[i].name, name) != 0)
+                i++;
+            if (i == ARRAY_SIZE(coverage_names))
+                ok = false;
+            else
+                flags |= coverage_names[i].flag;
+        }
+
+        for (unsigned int address = first; address <= last; address++)
+        {
+            map->flags[address] |= flags;
+        }
+    }
+    fclose(file);
+
+    if (!ok)
+        fprintf(stderr, "Coverage map %s is malformed\n", path);
+    return ok;
+}
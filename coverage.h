@@ -0,0 +1,41 @@
+#ifndef COVERAGE_H
+#define COVERAGE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "chip8.h"
+
+// Per-address record of how the guest used its memory, so tools know where code
+// ends and sprites begin instead of guessing
+#define COVERAGE_EXECUTED (1U << 0) // high byte of an executed instruction
+#define COVERAGE_OPERAND  (1U << 1) // low byte of an executed instruction
+#define COVERAGE_SPRITE   (1U << 2) // read by DXYN
+#define COVERAGE_READ     (1U << 3) // read by FX65
+#define COVERAGE_WRITTEN  (1U << 4) // written by FX33 or FX55
+
+typedef struct
+{
+    uint8_t flags[CHIP8_MEMORY_SIZE];
+} CoverageMap;
+
+void coverage_reset(CoverageMap *map);
+
+// chip8_step that also records into map
+Chip8Status chip8_step_coverage(Chip8 *chip8, CoverageMap *map);
+
+// Marks the instruction at the PC as executed and returns the flag its memory reads
+// count as, for other interpreters that record coverage through their own accessors
+uint8_t coverage_record_instruction(CoverageMap *map, const Chip8 *chip8, uint16_t opcode);
+
+// Text export, one line per run of addresses with the same flags. "code" covers
+// both bytes of every executed instruction:
+//   0200-0227 code
+//   0228-022c sprite
+//   0ea0-0eaf read+written
+// Addresses nothing touched are left out
+bool coverage_save_file(const CoverageMap *map, const char *rom_name, size_t rom_size, const char *path);
+bool coverage_load_file(CoverageMap *map, const char *path);
+
+#endif
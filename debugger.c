@@ -0,0 +1,300 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "debugger.h"
+
+#define BITMAP_WORDS (CHIP8_MEMORY_SIZE / 64)
+
+static uint64_t breakpoints[BITMAP_WORDS];
+static uint64_t read_watchpoints[BITMAP_WORDS];
+static uint64_t write_watchpoints[BITMAP_WORDS];
+static size_t breakpoint_count;
+static size_t watchpoint_count;
+
+// Breakpoint address the next step is allowed to execute, -1 for none
+static int32_t resume_address = -1;
+static bool watch_hit;
+static DebugStop last_stop;
+
+// Set while --coverage records, and how the current instruction's reads count
+static CoverageMap *coverage_map;
+static uint8_t coverage_read_flag;
+
+static inline bool bit_test(const uint64_t *bitmap, uint16_t address)
+{
+    return (bitmap[address / 64] >> (address % 64)) & 1;
+}
+
+static inline void bit_set(uint64_t *bitmap, uint16_t address)
+{
+    bitmap[address / 64] |= 1ULL << (address % 64);
+}
+
+static inline void bit_clear(uint64_t *bitmap, uint16_t address)
+{
+    bitmap[address / 64] &= ~(1ULL << (address % 64));
+}
+
+void debugger_add_breakpoint(uint16_t address)
+{
+    if (!bit_test(breakpoints, address))
+    {
+        bit_set(breakpoints, address);
+        breakpoint_count++;
+    }
+}
+
+void debugger_remove_breakpoint(uint16_t address)
+{
+    if (bit_test(breakpoints, address))
+    {
+        bit_clear(breakpoints, address);
+        breakpoint_count--;
+    }
+}
+
+void debugger_add_watchpoint(uint16_t first, uint16_t last, uint8_t access)
+{
+    for (uint32_t address = first; address <= last && address < CHIP8_MEMORY_SIZE; address++)
+    {
+        if (access & WATCH_READ)
+            bit_set(read_watchpoints, address);
+        if (access & WATCH_WRITE)
+            bit_set(write_watchpoints, address);
+    }
+    watchpoint_count++;
+}
+
+void debugger_clear(void)
+{
+    memset(breakpoints, 0, sizeof(breakpoints));
+    memset(read_watchpoints, 0, sizeof(read_watchpoints));
+    memset(write_watchpoints, 0, sizeof(write_watchpoints));
+    breakpoint_count = 0;
+    watchpoint_count = 0;
+    resume_address = -1;
+}
+
+bool debugger_active(void)
+{
+    return breakpoint_count > 0 || watchpoint_count > 0;
+}
+
+bool debugger_parse_breakpoint(const char *text)
+{
+    char *end;
+    unsigned long address = strtoul(text, &end, 0);
+    if (*end != '\0' || address >= CHIP8_MEMORY_SIZE)
+    {
+        fprintf(stderr, "Bad breakpoint address %s\n", text);
+        return false;
+    }
+    debugger_add_breakpoint(address);
+    return true;
+}
+
+bool debugger_parse_watchpoint(const char *text)
+{
+    char *end;
+    unsigned long first = strtoul(text, &end, 0);
+    unsigned long last = first;
+    if (*end == '-')
+        last = strtoul(end + 1, &end, 0);
+
+    uint8_t access = 0;
+    if (*end == '\0' || strcmp(end, ":rw") == 0)
+        access = WATCH_READ | WATCH_WRITE;
+    else if (strcmp(end, ":r") == 0)
+        access = WATCH_READ;
+    else if (strcmp(end, ":w") == 0)
+        access = WATCH_WRITE;
+
+    if (access == 0 || first > last || last >= CHIP8_MEMORY_SIZE)
+    {
+        fprintf(stderr, "Bad watchpoint %s, expected first[-last][:r|:w|:rw]\n", text);
+        return false;
+    }
+    debugger_add_watchpoint(first, last, access);
+    return true;
+}
+
+static inline void watch_stop(uint16_t address, uint8_t access, uint8_t old_value, uint8_t new_value)
+{
+    if (watch_hit)
+        return;
+    watch_hit = true;
+    last_stop.address = address;
+    last_stop.access = access;
+    last_stop.old_value = old_value;
+    last_stop.new_value = new_value;
+}
+
+static inline uint8_t debug_read(Chip8 *chip8, uint16_t address)
+{
+    address &= chip8->address_mask;
+    uint8_t value = CHIP8_MEMORY(chip8)[address];
+    if (coverage_map != NULL)
+        coverage_map->flags[address] |= coverage_read_flag;
+    if (bit_test(read_watchpoints, address))
+        watch_stop(address, WATCH_READ, value, value);
+    return value;
+}
+
+static inline void debug_write(Chip8 *chip8, uint16_t address, uint8_t value)
+{
+    address &= chip8->address_mask;
+    if (coverage_map != NULL)
+        coverage_map->flags[address] |= COVERAGE_WRITTEN;
+    if (bit_test(write_watchpoints, address))
+        watch_stop(address, WATCH_WRITE, CHIP8_MEMORY(chip8)[address], value);
+    CHIP8_MEMORY(chip8)[address] = value;
+}
+
+#define CHIP8_EXECUTE execute_instruction_debug
+#define CHIP8_MACHINE Chip8
+#define MEM_READ(m, addr) debug_read((m), (addr))
+#define MEM_WRITE(m, addr, value) debug_write((m), (addr), (value))
+#define CODE_READ(m, addr) (CHIP8_MEMORY(m)[(addr) & (m)->address_mask])
+#define DISPLAY(m) ((m)->display)
+#define DISPLAY_WRITE_BEGIN(m)
+#include "chip8_execute.inc"
+
+Chip8Status chip8_step_debug(Chip8 *chip8)
+{
+    uint16_t program_counter = chip8->program_counter & chip8->address_mask;
+    uint16_t opcode = chip8_fetch(chip8);
+
+    if (bit_test(breakpoints, program_counter) && resume_address != program_counter)
+    {
+        last_stop = (DebugStop){ .status = CHIP8_BREAKPOINT, .program_counter = program_counter, .opcode = opcode };
+        return CHIP8_BREAKPOINT;
+    }
+    resume_address = -1;
+
+    if (coverage_map != NULL)
+        coverage_read_flag = coverage_record_instruction(coverage_map, chip8, opcode);
+    watch_hit = false;
+    Chip8Status status = execute_instruction_debug(chip8, opcode);
+    if (status == CHIP8_OK && watch_hit)
+    {
+        last_stop.status = CHIP8_WATCHPOINT;
+        last_stop.program_counter = program_counter;
+        last_stop.opcode = opcode;
+        return CHIP8_WATCHPOINT;
+    }
+    last_stop.status = status;
+    return status;
+}
+
+static bool range_watched(const Chip8 *chip8, const uint64_t *bitmap, uint16_t first, uint16_t count)
+{
+    for (uint16_t i = 0; i < count; i++)
+    {
+        if (bit_test(bitmap, (first + i) & chip8->address_mask))
+            return true;
+    }
+    return false;
+}
+
+bool debugger_would_stop(const Chip8 *chip8)
+{
+    if (bit_test(breakpoints, chip8->program_counter & chip8->address_mask))
+        return true;
+    if (watchpoint_count == 0)
+        return false;
+
+    uint16_t opcode = chip8_fetch(chip8);
+    uint8_t x = (opcode >> 8) & 0xF;
+    if ((opcode & 0xF000) == DRAW_SPRITE)
+    {
+        // SUPER-CHIP DXY0 reads a 16x16 sprite, XO-CHIP reads one sprite per selected plane
+        uint16_t rows = opcode & 0xF;
+        uint16_t row_size = 1;
+        if (rows == 0 && chip8->platform != CHIP8_PLATFORM_CHIP8)
+        {
+            rows = 16;
+            row_size = 2;
+        }
+        uint16_t sprite_size = rows * row_size;
+
+        // Rows clipped at the bottom edge are never read
+        uint32_t height = chip8->hires ? CHIP8_HIRES_HEIGHT : HEIGHT;
+        uint32_t y = chip8->registers.V[(opcode >> 4) & 0xF] % height;
+        if ((chip8->quirks & CHIP8_QUIRK_CLIP) && y + rows > height)
+            rows = height - y;
+
+        uint16_t start = chip8->I;
+        for (uint32_t plane = 0; plane < CHIP8_PLANE_COUNT; plane++)
+        {
+            if (!(chip8->planes & (1U << plane)))
+                continue;
+            if (range_watched(chip8, read_watchpoints, start, rows * row_size))
+                return true;
+            start += sprite_size;
+        }
+        return false;
+    }
+    if ((opcode & 0xF00E) == SAVE_RANGE && chip8->platform == CHIP8_PLATFORM_XOCHIP)
+    {
+        uint8_t y = (opcode >> 4) & 0xF;
+        uint16_t count = (x < y ? y - x : x - y) + 1;
+        return range_watched(chip8, opcode & 1 ? read_watchpoints : write_watchpoints, chip8->I, count);
+    }
+    if ((opcode & 0xF0FF) == SET_BCD_VX)
+        return range_watched(chip8, write_watchpoints, chip8->I, 3);
+    if ((opcode & 0xF0FF) == REG_DUMP)
+        return range_watched(chip8, write_watchpoints, chip8->I, x + 1);
+    if ((opcode & 0xF0FF) == REG_LOAD)
+        return range_watched(chip8, read_watchpoints, chip8->I, x + 1);
+    if (opcode == LOAD_AUDIO_PATTERN && chip8->platform == CHIP8_PLATFORM_XOCHIP)
+        return range_watched(chip8, read_watchpoints, chip8->I, CHIP8_AUDIO_PATTERN_SIZE);
+    return false;
+}
+
+void debugger_set_coverage(CoverageMap *map)
+{
+    coverage_map = map;
+}
+
+void debugger_resume(const Chip8 *chip8)
+{
+    // After a watchpoint the PC is already past the instruction that stopped, a
+    // breakpoint there has not been reached yet
+    uint16_t program_counter = chip8->program_counter & chip8->address_mask;
+    if (last_stop.status == CHIP8_BREAKPOINT && last_stop.program_counter == program_counter)
+        resume_address = program_counter;
+}
+
+const DebugStop *debugger_last_stop(void)
+{
+    return &last_stop;
+}
+
+void debugger_print_registers(const Chip8 *chip8)
+{
+    printf("  PC=0x%03x I=0x%03x SP=%u DT=%u ST=%u next=%04x\n ", chip8->program_counter, chip8->I,
+           chip8->stack.stack_pointer, chip8->delay_timer, chip8->sound_timer, chip8_fetch(chip8));
+    for (size_t i = 0; i < 16; i++)
+    {
+        printf(" V%zX=%02x", i, chip8->registers.V[i]);
+    }
+    printf("\n");
+}
+
+void debugger_print_stop(const Chip8 *chip8)
+{
+    if (last_stop.status == CHIP8_WATCHPOINT)
+    {
+        printf("Watchpoint: %04x at 0x%03x %s 0x%03x", last_stop.opcode, last_stop.program_counter,
+               last_stop.access == WATCH_READ ? "read" : "wrote", last_stop.address);
+        if (last_stop.access == WATCH_WRITE)
+            printf(" (0x%02x -> 0x%02x)", last_stop.old_value, last_stop.new_value);
+        printf("\n");
+    }
+    else if (last_stop.status == CHIP8_BREAKPOINT)
+    {
+        printf("Breakpoint: %04x at 0x%03x\n", last_stop.opcode, last_stop.program_counter);
+    }
+    debugger_print_registers(chip8);
+}
@@ -0,0 +1,61 @@
+#ifndef DEBUGGER_H
+#define DEBUGGER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "chip8.h"
+#include "coverage.h"
+
+// PC breakpoints and memory watchpoints, all kept as one bit per guest address.
+// They are only checked by chip8_step_debug, a separate instance of the interpreter
+// the frontend switches to while debugger_active() is true, so runs without any
+// breakpoints or watchpoints use the plain chip8_step and pay nothing
+
+#define WATCH_READ  (1U << 0) // DXYN, FX65 and F002
+#define WATCH_WRITE (1U << 1) // FX33 and FX55
+
+typedef struct
+{
+    Chip8Status status;
+    uint16_t program_counter;
+    uint16_t opcode;
+    // Watchpoints only: first watched address the instruction touched
+    uint16_t address;
+    uint8_t access;
+    uint8_t old_value;
+    uint8_t new_value;
+} DebugStop;
+
+void debugger_add_breakpoint(uint16_t address);
+void debugger_remove_breakpoint(uint16_t address);
+void debugger_add_watchpoint(uint16_t first, uint16_t last, uint8_t access);
+void debugger_clear(void);
+bool debugger_active(void);
+
+// Parses "0x2a0" or "0x2a0-0x2af[:r|:w|:rw]" as given on the command line
+bool debugger_parse_breakpoint(const char *text);
+bool debugger_parse_watchpoint(const char *text);
+
+// Stops before executing an instruction at a breakpoint (the machine is left
+// untouched) and after an instruction that touched a watched address
+Chip8Status chip8_step_debug(Chip8 *chip8);
+
+// True when chip8_step_debug would stop on the instruction at the current PC. Works
+// out the accessed range from the opcode instead of executing it, for scanning history
+bool debugger_would_stop(const Chip8 *chip8);
+
+// Makes chip8_step_debug record coverage into map too, NULL stops it
+void debugger_set_coverage(CoverageMap *map);
+
+// Lets the next chip8_step_debug execute the instruction at the breakpoint the machine
+// last stopped at, when it is still there
+void debugger_resume(const Chip8 *chip8);
+
+const DebugStop *debugger_last_stop(void);
+void debugger_print_registers(const Chip8 *chip8);
+// Why the machine stopped, followed by its registers
+void debugger_print_stop(const Chip8 *chip8);
+
+#endif
@@ -0,0 +1,407 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "diffcheck.h"
+#include "fork.h"
+#include "host_time.h"
+#include "statehash.h"
+
+static void hashed_load(void *machine, const Chip8 *initial)
+{
+    Chip8 *chip8 = machine;
+    chip8_copy(chip8, initial);
+    chip8_hash_rebuild(chip8);
+}
+
+static void hashed_release(void *machine)
+{
+    chip8_free(machine);
+}
+
+static Chip8Status hashed_step(void *machine)
+{
+    return chip8_step_hashed(machine);
+}
+
+static void hashed_tick_timers(void *machine)
+{
+    chip8_tick_timers(machine);
+}
+
+static void hashed_set_keypad(void *machine, uint16_t keypad)
+{
+    ((Chip8 *)machine)->keypad = keypad;
+}
+
+static uint64_t hashed_hash(const void *machine)
+{
+    return chip8_hash(machine);
+}
+
+static void hashed_to_machine(const void *machine, Chip8 *chip8)
+{
+    chip8_copy(chip8, machine);
+}
+
+static const ExecutionEngine hashed_engine = {
+    .name = "hashed",
+    .machine_size = sizeof(Chip8),
+    .load = hashed_load,
+    .release = hashed_release,
+    .step = hashed_step,
+    .tick_timers = hashed_tick_timers,
+    .set_keypad = hashed_set_keypad,
+    .hash = hashed_hash,
+    .to_machine = hashed_to_machine,
+};
+
+static void fork_engine_load(void *machine, const Chip8 *initial)
+{
+    fork_from_machine(machine, initial);
+}
+
+static void fork_engine_release(void *machine)
+{
+    fork_release(machine);
+}
+
+static Chip8Status fork_engine_step(void *machine)
+{
+    return fork_step(machine);
+}
+
+static void fork_engine_tick_timers(void *machine)
+{
+    fork_tick_timers(machine);
+}
+
+static void fork_engine_set_keypad(void *machine, uint16_t keypad)
+{
+    ((Chip8Fork *)machine)->keypad = keypad;
+}
+
+static uint64_t fork_engine_hash(const void *machine)
+{
+    return fork_hash(machine);
+}
+
+static void fork_engine_to_machine(const void *machine, Chip8 *chip8)
+{
+    fork_to_machine(machine, chip8);
+}
+
+static const ExecutionEngine fork_engine = {
+    .name = "fork",
+    .machine_size = sizeof(Chip8Fork),
+    .load = fork_engine_load,
+    .release = fork_engine_release,
+    .step = fork_engine_step,
+    .tick_timers = fork_engine_tick_timers,
+    .set_keypad = fork_engine_set_keypad,
+    .hash = fork_engine_hash,
+    .to_machine = fork_engine_to_machine,
+};
+
+const ExecutionEngine *const diffcheck_engines[] = {
+    &hashed_engine,
+    &fork_engine,
+    NULL,
+};
+
+const ExecutionEngine *diffcheck_find_engine(const char *name)
+{
+    for (size_t i = 0; diffcheck_engines[i] != NULL; i++)
+    {
+        if (strcmp(diffcheck_engines[i]->name, name) == 0)
+            return diffcheck_engines[i];
+    }
+    return NULL;
+}
+
+// Scripted input: holds a random key (or nothing) for a random number of frames,
+// enough to get past FX0A waits and menus in most ROMs
+static uint16_t scripted_keypad(uint32_t *rng_state, uint32_t *frames_left, uint16_t keypad)
+{
+    if (*frames_left > 0)
+    {
+        (*frames_left)--;
+        return keypad;
+    }
+
+    uint8_t roll = chip8_random_next(rng_state);
+    *frames_left = 2 + (roll & 0x1F);
+    if (roll & 0x80)
+        return 0;
+    return 1U << (chip8_random_next(rng_state) % CHIP8_KEY_COUNT);
+}
+
+static bool machines_equal(const Chip8 *a, const Chip8 *b)
+{
+    return a->address_mask == b->address_mask
+           && memcmp(CHIP8_MEMORY(a), CHIP8_MEMORY(b), chip8_memory_size(a)) == 0
+           && memcmp(a->registers.V, b->registers.V, sizeof(a->registers.V)) == 0
+           && a->I == b->I
+           && memcmp(a->stack.stack_arr, b->stack.stack_arr, sizeof(a->stack.stack_arr)) == 0
+           && a->stack.stack_pointer == b->stack.stack_pointer
+           && a->program_counter == b->program_counter
+           && a->delay_timer == b->delay_timer
+           && a->sound_timer == b->sound_timer
+           && a->rng_state == b->rng_state
+           && memcmp(a->audio_pattern, b->audio_pattern, sizeof(a->audio_pattern)) == 0
+           && a->pitch == b->pitch
+           && a->hires == b->hires
+           && a->planes == b->planes
+           && a->quirks == b->quirks
+           && a->vblank == b->vblank
+           && memcmp(a->rpl, b->rpl, sizeof(a->rpl)) == 0
+           && memcmp(a->display, b->display, sizeof(a->display)) == 0;
+}
+
+static void release_machines(const ExecutionEngine *engine, void *machine, Chip8 *reference, Chip8 *actual)
+{
+    engine->release(machine);
+    free(machine);
+    chip8_free(reference);
+    chip8_free(actual);
+}
+
+static void report_state_diff(FILE *report, const Chip8 *expected, const Chip8 *actual)
+{
+    for (size_t i = 0; i < 16; i++)
+    {
+        if (expected->registers.V[i] != actual->registers.V[i])
+            fprintf(report, "    V%zX   expected 0x%02x, got 0x%02x\n", i,
+                    expected->registers.V[i], actual->registers.V[i]);
+    }
+
+#define REPORT_FIELD(field, format)                                                      \
+    if (expected->field != actual->field)                                                \
+        fprintf(report, "    %-4s expected " format ", got " format "\n", #field,        \
+                expected->field, actual->field)
+
+    REPORT_FIELD(I, "0x%03x");
+    REPORT_FIELD(program_counter, "0x%03x");
+    REPORT_FIELD(stack.stack_pointer, "%u");
+    REPORT_FIELD(delay_timer, "%u");
+    REPORT_FIELD(sound_timer, "%u");
+    REPORT_FIELD(rng_state, "0x%08x");
+    REPORT_FIELD(pitch, "%u");
+    REPORT_FIELD(hires, "%u");
+    REPORT_FIELD(planes, "%u");
+    REPORT_FIELD(address_mask, "0x%04x");
+    REPORT_FIELD(vblank, "%u");
+#undef REPORT_FIELD
+
+    for (size_t i = 0; i < CHIP8_STACK_SIZE; i++)
+    {
+        if (expected->stack.stack_arr[i] != actual->stack.stack_arr[i])
+            fprintf(report, "    stack[%zu] expected 0x%03x, got 0x%03x\n", i,
+                    expected->stack.stack_arr[i], actual->stack.stack_arr[i]);
+    }
+
+    // Past the smaller of the two memories there is nothing to compare
+    const uint8_t *expected_memory = CHIP8_MEMORY(expected);
+    const uint8_t *actual_memory = CHIP8_MEMORY(actual);
+    size_t memory_size = chip8_memory_size(expected) < chip8_memory_size(actual)
+                         ? chip8_memory_size(expected) : chip8_memory_size(actual);
+    size_t first_memory = 0;
+    size_t memory_diffs = 0;
+    for (size_t i = 0; i < memory_size; i++)
+    {
+        if (expected_memory[i] != actual_memory[i])
+        {
+            if (memory_diffs++ == 0)
+                first_memory = i;
+        }
+    }
+    if (memory_diffs > 0)
+        fprintf(report, "    memory: %zu bytes differ, first at 0x%03zx (expected 0x%02x, got 0x%02x)\n",
+                memory_diffs, first_memory, expected_memory[first_memory], actual_memory[first_memory]);
+
+    for (size_t i = 0; i < CHIP8_FLAG_REGISTER_COUNT; i++)
+    {
+        if (expected->rpl[i] != actual->rpl[i])
+            fprintf(report, "    rpl[%zu] expected 0x%02x, got 0x%02x\n", i, expected->rpl[i], actual->rpl[i]);
+    }
+
+    size_t pixel_diffs = 0;
+    for (size_t plane = 0; plane < CHIP8_PLANE_COUNT; plane++)
+    {
+        for (size_t y = 0; y < CHIP8_HIRES_HEIGHT; y++)
+        {
+            for (size_t word = 0; word < CHIP8_DISPLAY_WORDS; word++)
+            {
+                for (uint64_t diff = expected->display[plane][y][word] ^ actual->display[plane][y][word];
+                     diff != 0; diff &= diff - 1)
+                {
+                    pixel_diffs++;
+                }
+            }
+        }
+    }
+    if (pixel_diffs > 0)
+        fprintf(report, "    display: %zu pixels differ\n", pixel_diffs);
+}
+
+// Replays one interval from its starting states instruction by instruction and
+// reports the first instruction after which the two machines differ
+static void locate_divergence(const ExecutionEngine *engine, const Chip8 *start,
+                              const Chip8 *engine_start, uint32_t start_frame,
+                              const uint16_t *keypads, const DiffCheckConfig *config, FILE *report)
+{
+    Chip8 reference = { 0 };
+    chip8_copy(&reference, start);
+    void *machine = calloc(1, engine->machine_size);
+    if (machine == NULL)
+    {
+        fprintf(stderr, "ERROR: out of memory while checking engine %s\n", engine->name);
+        exit(1);
+    }
+    engine->load(machine, engine_start);
+
+    Chip8 actual = { 0 };
+    engine->to_machine(machine, &actual);
+    if (!machines_equal(&reference, &actual))
+    {
+        fprintf(report, "  engine %s does not reproduce the state it was loaded from\n", engine->name);
+        report_state_diff(report, &reference, &actual);
+        release_machines(engine, machine, &reference, &actual);
+        return;
+    }
+
+    for (uint32_t frame = 0; frame < config->interval; frame++)
+    {
+        reference.keypad = keypads[frame];
+        engine->set_keypad(machine, keypads[frame]);
+        chip8_tick_timers(&reference);
+        engine->tick_timers(machine);
+
+        engine->to_machine(machine, &actual);
+        if (!machines_equal(&reference, &actual))
+        {
+            fprintf(report, "  frame %u: diverged in the timer tick\n", start_frame + frame);
+            report_state_diff(report, &reference, &actual);
+            break;
+        }
+
+        for (uint32_t step = 0; step < config->instructions_per_frame; step++)
+        {
+            uint16_t program_counter = reference.program_counter;
+            uint16_t opcode = chip8_fetch(&reference);
+            Chip8Status expected_status = chip8_step(&reference);
+            Chip8Status actual_status = engine->step(machine);
+
+            engine->to_machine(machine, &actual);
+            if (expected_status != actual_status || !machines_equal(&reference, &actual))
+            {
+                fprintf(report, "  frame %u, instruction %u: PC=0x%03x opcode=0x%04x\n",
+                        start_frame + frame, step, program_counter, opcode);
+                if (expected_status != actual_status)
+                    fprintf(report, "    status expected %s, got %s\n",
+                            chip8_status_name(expected_status), chip8_status_name(actual_status));
+                report_state_diff(report, &reference, &actual);
+                release_machines(engine, machine, &reference, &actual);
+        return;
+            }
+            if (expected_status != CHIP8_OK)
+                break;
+        }
+    }
+
+    // Either the engine's hash is wrong or it does not behave the same when run again
+    fprintf(report, "  replaying the interval step by step did not reproduce the mismatch\n");
+    release_machines(engine, machine, &reference, &actual);
+}
+
+bool diffcheck_run(const ExecutionEngine *engine, const uint8_t *rom, size_t rom_size,
+                   const DiffCheckConfig *config, FILE *report, DiffCheckResult *result)
+{
+    memset(result, 0, sizeof(*result));
+
+    Chip8 reference;
+    chip8_init(&reference, config->seed);
+    chip8_set_platform(&reference, config->platform);
+    chip8_set_quirks(&reference, config->quirks);
+    if (!chip8_load_program(&reference, rom, rom_size))
+    {
+        chip8_free(&reference);
+        return false;
+    }
+
+    void *machine = calloc(1, engine->machine_size);
+    uint16_t *keypads = malloc(config->interval * sizeof(uint16_t));
+    if (machine == NULL || keypads == NULL)
+    {
+        fprintf(stderr, "ERROR: out of memory while checking engine %s\n", engine->name);
+        exit(1);
+    }
+    engine->load(machine, &reference);
+
+    // Start of the current interval, kept to find the exact instruction on a mismatch
+    Chip8 interval_start = { 0 };
+    Chip8 engine_interval_start = { 0 };
+    chip8_copy(&interval_start, &reference);
+    chip8_copy(&engine_interval_start, &reference);
+    uint32_t interval_frame = 0;
+
+    uint32_t input_rng = config->seed ? config->seed : CHIP8_DEFAULT_SEED;
+    uint32_t hold_frames = 0;
+    uint16_t keypad = 0;
+
+    uint64_t start_ns = host_time_ns();
+    for (uint32_t frame = 0; frame < config->frames; frame++)
+    {
+        keypad = scripted_keypad(&input_rng, &hold_frames, keypad);
+        keypads[frame - interval_frame] = keypad;
+
+        reference.keypad = keypad;
+        engine->set_keypad(machine, keypad);
+        chip8_tick_timers(&reference);
+        engine->tick_timers(machine);
+
+        Chip8Status expected_status = CHIP8_OK;
+        Chip8Status actual_status = CHIP8_OK;
+        for (uint32_t step = 0; step < config->instructions_per_frame; step++)
+        {
+            expected_status = chip8_step(&reference);
+            actual_status = engine->step(machine);
+            if (expected_status != CHIP8_OK || actual_status != CHIP8_OK)
+                break;
+        }
+
+        bool stopped = expected_status != CHIP8_OK || actual_status != CHIP8_OK;
+        if (!stopped && frame + 1 - interval_frame < config->interval && frame + 1 < config->frames)
+            continue;
+
+        if (expected_status != actual_status || chip8_hash_full(&reference) != engine->hash(machine))
+        {
+            fprintf(report, "%s diverged between frames %u and %u\n", engine->name, interval_frame, frame);
+            locate_divergence(engine, &interval_start, &engine_interval_start, interval_frame,
+                              keypads, config, report);
+            result->diverged = true;
+            break;
+        }
+
+        result->frames_checked = frame + 1;
+        if (stopped)
+        {
+            // Both trapped on the same instruction, nothing left to compare
+            result->status = expected_status;
+            fprintf(report, "  stopped in frame %u: %s at PC=0x%03x\n", frame,
+                    chip8_status_name(expected_status), reference.program_counter);
+            break;
+        }
+        chip8_copy(&interval_start, &reference);
+        engine->to_machine(machine, &engine_interval_start);
+        interval_frame = frame + 1;
+    }
+    result->elapsed_ns = host_time_ns() - start_ns;
+
+    engine->release(machine);
+    free(machine);
+    free(keypads);
+    chip8_free(&reference);
+    chip8_free(&interval_start);
+    chip8_free(&engine_interval_start);
+    return !result->diverged;
+}
@@ -0,0 +1,63 @@
+#ifndef DIFFCHECK_H
+#define DIFFCHECK_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "chip8.h"
+
+// Lock-step differential checking of an execution engine against the reference
+// execute_instruction. Both run the same ROM with the same scripted input, their
+// state hashes are compared every interval frames, and on a mismatch the last
+// interval is replayed one instruction at a time to find the first one that diverged.
+//
+// Adding an engine means filling in an ExecutionEngine and listing it in diffcheck_engines
+
+typedef struct
+{
+    const char *name;
+    // Bytes of opaque machine storage the engine needs
+    size_t machine_size;
+    // Starts the engine from a flat machine, the engine may allocate
+    void (*load)(void *machine, const Chip8 *initial);
+    void (*release)(void *machine);
+    Chip8Status (*step)(void *machine);
+    void (*tick_timers)(void *machine);
+    void (*set_keypad)(void *machine, uint16_t keypad);
+    uint64_t (*hash)(const void *machine);
+    void (*to_machine)(const void *machine, Chip8 *chip8);
+} ExecutionEngine;
+
+extern const ExecutionEngine *const diffcheck_engines[];
+
+typedef struct
+{
+    uint32_t frames;
+    uint32_t instructions_per_frame;
+    // Hashes are compared every this many frames
+    uint32_t interval;
+    // Seeds both the PRNG and the scripted keypad input
+    uint32_t seed;
+    Chip8Platform platform;
+    uint8_t quirks;
+} DiffCheckConfig;
+
+typedef struct
+{
+    bool diverged;
+    uint32_t frames_checked;
+    // Trap both machines stopped on, CHIP8_OK when the ROM ran for all frames
+    Chip8Status status;
+    uint64_t elapsed_ns;
+} DiffCheckResult;
+
+const ExecutionEngine *diffcheck_find_engine(const char *name);
+
+// Runs engine against the reference on rom, a divergence report is written to report.
+// Returns false when the two disagree
+bool diffcheck_run(const ExecutionEngine *engine, const uint8_t *rom, size_t rom_size,
+                   const DiffCheckConfig *config, FILE *report, DiffCheckResult *result);
+
+#endif
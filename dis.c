@@ -0,0 +1,568 @@
+// chip8-dis: recursive-traversal disassembler. Follows control flow from 0x200
+// (plus any code addresses in a coverage map), splits the reached code into basic
+// blocks and functions, and prints an annotated listing or Graphviz DOT.
+//
+//   chip8-dis [--map coverage.map] [--cfg | --calls] rom.ch8
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "chip8.h"
+#include "coverage.h"
+
+typedef enum
+{
+    FLOW_NEXT,
+    FLOW_JUMP,
+    FLOW_CALL,
+    FLOW_RETURN,
+    FLOW_SKIP,
+    FLOW_INDIRECT,
+} Flow;
+
+typedef struct
+{
+    uint16_t mask;
+    uint16_t pattern;
+    // %X, %Y register nibbles, %K byte, %N address, %B raw jump table base, %n low nibble
+    const char *format;
+    Flow flow;
+} OpcodeInfo;
+
+// Decoded the same way as chip8_execute.inc, 5XYN and the 8XYN forms included
+static const OpcodeInfo opcode_table[] = {
+    { 0xFFFF, CLEAR_SCREEN, "CLS", FLOW_NEXT },
+    { 0xFFFF, RETURN_SUBROUTINE, "RET", FLOW_RETURN },
+    { 0xF000, JUMP_ADDR, "JP   %N", FLOW_JUMP },
+    { 0xF000, CALL, "CALL %N", FLOW_CALL },
+    { 0xF000, SKIP_IF_EQ_IMM, "SE   V%X, %K", FLOW_SKIP },
+    { 0xF000, SKIP_IF_NEQ_IMM, "SNE  V%X, %K", FLOW_SKIP },
+    { 0xF000, SKIP_IF_EQ, "SE   V%X, V%Y", FLOW_SKIP },
+    { 0xF000, ASSIGN_VX_IMM, "LD   V%X, %K", FLOW_NEXT },
+    { 0xF000, ADD_VX_IMM, "ADD  V%X, %K", FLOW_NEXT },
+    { 0xF00F, ASSIGN_VX_VY, "LD   V%X, V%Y", FLOW_NEXT },
+    { 0xF00F, OR_VX_VY, "OR   V%X, V%Y", FLOW_NEXT },
+    { 0xF00F, AND_VX_VY, "AND  V%X, V%Y", FLOW_NEXT },
+    { 0xF00F, XOR_VX_VY, "XOR  V%X, V%Y", FLOW_NEXT },
+    { 0xF00F, ADD_VX_VY, "ADD  V%X, V%Y", FLOW_NEXT },
+    { 0xF00F, SUB_VX_VY, "SUB  V%X, V%Y", FLOW_NEXT },
+    { 0xF00F, RIGHT_SHIFT_VX_VY, "SHR  V%X, V%Y", FLOW_NEXT },
+    { 0xF00F, VX_SUB_VY, "SUBN V%X, V%Y", FLOW_NEXT },
+    { 0xF00F, LEFT_SHIFT_VX_VY, "SHL  V%X, V%Y", FLOW_NEXT },
+    { 0xF00F, SKIP_IF_NEQ, "SNE  V%X, V%Y", FLOW_SKIP },
+    { 0xF000, SET_I_ADDR, "LD   I, %N", FLOW_NEXT },
+    { 0xF000, JUMP_PLUS_V0, "JP   V0, %B", FLOW_INDIRECT },
+    { 0xF000, RAND, "RND  V%X, %K", FLOW_NEXT },
+    { 0xF000, DRAW_SPRITE, "DRW  V%X, V%Y, %n", FLOW_NEXT },
+    { 0xF0FF, SKIP_IF_KEY_PRESSED, "SKP  V%X", FLOW_SKIP },
+    { 0xF0FF, SKIP_IF_KEY_NOT_PRESSED, "SKNP V%X", FLOW_SKIP },
+    { 0xF0FF, SET_VX_TIMER, "LD   V%X, DT", FLOW_NEXT },
+    { 0xF0FF, KEY_AWAIT_STORE, "LD   V%X, K", FLOW_NEXT },
+    { 0xF0FF, SET_DELAY_TIMER, "LD   DT, V%X", FLOW_NEXT },
+    { 0xF0FF, SET_SOUND_TIMER, "LD   ST, V%X", FLOW_NEXT },
+    { 0xF0FF, ADD_I_VX, "ADD  I, V%X", FLOW_NEXT },
+    { 0xF0FF, SET_I_SPRITE_LOCATION, "LD   F, V%X", FLOW_NEXT },
+    { 0xF0FF, SET_BCD_VX, "LD   B, V%X", FLOW_NEXT },
+    { 0xF0FF, REG_DUMP, "LD   [I], V%X", FLOW_NEXT },
+    { 0xF0FF, REG_LOAD, "LD   V%X, [I]", FLOW_NEXT },
+    { 0xFFFF, LOAD_AUDIO_PATTERN, "AUDIO", FLOW_NEXT },
+    { 0xF0FF, SET_PITCH_VX, "PITCH V%X", FLOW_NEXT },
+    { 0xFFF0, SCROLL_DOWN, "SCD  %n", FLOW_NEXT },
+    { 0xFFFF, SCROLL_RIGHT, "SCR", FLOW_NEXT },
+    { 0xFFFF, SCROLL_LEFT, "SCL", FLOW_NEXT },
+    { 0xFFFF, LOW_RESOLUTION, "LOW", FLOW_NEXT },
+    { 0xFFFF, HIGH_RESOLUTION, "HIGH", FLOW_NEXT },
+    { 0xF0FF, SET_I_BIG_SPRITE, "LD   HF, V%X", FLOW_NEXT },
+    { 0xF0FF, SAVE_FLAGS, "LD   R, V%X", FLOW_NEXT },
+    { 0xF0FF, LOAD_FLAGS, "LD   V%X, R", FLOW_NEXT },
+};
+
+// Per-address facts found by the traversal
+#define ADDR_CODE     (1U << 0) // an instruction starts here
+#define ADDR_LEADER   (1U << 1) // a basic block starts here
+#define ADDR_FUNCTION (1U << 2) // 0x200 or a CALL target
+#define ADDR_DATA_REF (1U << 3) // loaded into I by ANNN
+#define ADDR_INVALID  (1U << 4) // reached, but not an instruction
+#define ADDR_QUEUED   (1U << 5)
+
+typedef struct
+{
+    uint16_t from;
+    uint16_t to;
+    Flow flow;
+    // For skips, whether this edge is the skipping one
+    bool taken;
+} Edge;
+
+// CHIP-8 and SUPER-CHIP programs only, the call graph table is quadratic in this
+#define DIS_MEMORY_SIZE CHIP8_CLASSIC_MEMORY_SIZE
+#define DIS_ADDRESS_MASK (DIS_MEMORY_SIZE - 1)
+
+static uint8_t memory[DIS_MEMORY_SIZE];
+static size_t rom_end;
+static uint8_t address_flags[DIS_MEMORY_SIZE];
+static uint16_t function_of[DIS_MEMORY_SIZE];
+
+static Edge *edges;
+static size_t edge_count;
+static size_t edge_capacity;
+
+static uint16_t worklist[DIS_MEMORY_SIZE];
+static size_t worklist_length;
+
+static const CoverageMap *coverage_map;
+
+static uint16_t fetch(uint16_t address)
+{
+    return ((uint16_t)memory[address & DIS_ADDRESS_MASK] << 8) | memory[(address + 1) & DIS_ADDRESS_MASK];
+}
+
+static const OpcodeInfo *decode(uint16_t opcode)
+{
+    for (size_t i = 0; i < ARRAY_SIZE(opcode_table); i++)
+    {
+        if ((opcode & opcode_table[i].mask) == opcode_table[i].pattern)
+            return &opcode_table[i];
+    }
+    return NULL;
+}
+
+static void add_edge(uint16_t from, uint16_t to, Flow flow, bool taken)
+{
+    if (edge_count == edge_capacity)
+    {
+        edge_capacity = edge_capacity ? edge_capacity * 2 : 256;
+        edges = realloc(edges, edge_capacity * sizeof(Edge));
+        if (edges == NULL)
+        {
+            fprintf(stderr, "ERROR: out of memory\n");
+            exit(1);
+        }
+    }
+    edges[edge_count++] = (Edge){ .from = from, .to = to & DIS_ADDRESS_MASK, .flow = flow, .taken = taken };
+}
+
+static void visit(uint16_t address, uint8_t flags)
+{
+    address &= DIS_ADDRESS_MASK;
+    address_flags[address] |= flags;
+    if (!(address_flags[address] & ADDR_QUEUED))
+    {
+        address_flags[address] |= ADDR_QUEUED;
+        worklist[worklist_length++] = address;
+    }
+}
+
+// Discovers every reachable instruction and the edges between them
+static void traverse(void)
+{
+    while (worklist_length > 0)
+    {
+        uint16_t address = worklist[--worklist_length];
+        uint16_t opcode = fetch(address);
+        const OpcodeInfo *info = decode(opcode);
+        if (info == NULL)
+        {
+            address_flags[address] |= ADDR_INVALID;
+            continue;
+        }
+        address_flags[address] |= ADDR_CODE;
+
+        uint16_t next = address + INSTRUCTION_SIZE;
+        uint16_t target = opcode & 0x0FFF;
+        switch (info->flow)
+        {
+        case FLOW_NEXT:
+            if ((opcode & 0xF000) == SET_I_ADDR)
+                address_flags[target] |= ADDR_DATA_REF;
+            add_edge(address, next, FLOW_NEXT, false);
+            visit(next, 0);
+            break;
+        case FLOW_JUMP:
+            add_edge(address, target, FLOW_JUMP, true);
+            visit(target, ADDR_LEADER);
+            break;
+        case FLOW_CALL:
+            add_edge(address, target, FLOW_CALL, true);
+            visit(target, ADDR_LEADER | ADDR_FUNCTION);
+            add_edge(address, next, FLOW_NEXT, false);
+            visit(next, 0);
+            break;
+        case FLOW_SKIP:
+            add_edge(address, next, FLOW_SKIP, false);
+            add_edge(address, next + INSTRUCTION_SIZE, FLOW_SKIP, true);
+            visit(next, ADDR_LEADER);
+            visit(next + INSTRUCTION_SIZE, ADDR_LEADER);
+            break;
+        case FLOW_RETURN:
+        case FLOW_INDIRECT:
+            // Targets only known at run time, a coverage map can fill them in
+            break;
+        }
+    }
+}
+
+static bool ends_block(uint16_t address)
+{
+    const OpcodeInfo *info = decode(fetch(address));
+    return info->flow != FLOW_NEXT && info->flow != FLOW_CALL;
+}
+
+static bool is_block_start(uint16_t address)
+{
+    if (!(address_flags[address] & ADDR_CODE))
+        return false;
+    if (address_flags[address] & ADDR_LEADER)
+        return true;
+    // Code nothing falls into, e.g. only reached through a coverage map
+    return address < INSTRUCTION_SIZE
+           || !(address_flags[address - INSTRUCTION_SIZE] & ADDR_CODE)
+           || ends_block(address - INSTRUCTION_SIZE);
+}
+
+// Each block belongs to the first function that reaches it without going through a call
+static void assign_functions(void)
+{
+    memset(function_of, 0xFF, sizeof(function_of));
+
+    for (size_t entry = 0; entry < DIS_MEMORY_SIZE; entry++)
+    {
+        if (!(address_flags[entry] & ADDR_FUNCTION) || function_of[entry] != 0xFFFF)
+            continue;
+
+        worklist_length = 0;
+        worklist[worklist_length++] = entry;
+        function_of[entry] = entry;
+        while (worklist_length > 0)
+        {
+            uint16_t address = worklist[--worklist_length];
+            for (size_t i = 0; i < edge_count; i++)
+            {
+                if (edges[i].from != address || edges[i].flow == FLOW_CALL)
+                    continue;
+                uint16_t to = edges[i].to;
+                if ((address_flags[to] & ADDR_CODE) && function_of[to] == 0xFFFF)
+                {
+                    function_of[to] = entry;
+                    worklist[worklist_length++] = to;
+                }
+            }
+        }
+    }
+}
+
+static void label(char *out, size_t size, uint16_t address)
+{
+    if (address_flags[address] & ADDR_FUNCTION)
+        snprintf(out, size, "sub_%03x", address);
+    else if (address_flags[address] & ADDR_CODE)
+        snprintf(out, size, "loc_%03x", address);
+    else if (address_flags[address] & ADDR_DATA_REF)
+        snprintf(out, size, "data_%03x", address);
+    else
+        snprintf(out, size, "0x%03x", address);
+}
+
+static void format_instruction(char *out, size_t size, uint16_t opcode)
+{
+    const OpcodeInfo *info = decode(opcode);
+    size_t n = 0;
+    for (const char *c = info->format; *c != '\0' && n + 16 < size; c++)
+    {
+        if (*c != '%')
+        {
+            out[n++] = *c;
+            continue;
+        }
+
+        switch (*++c)
+        {
+        case 'X':
+            n += snprintf(out + n, size - n, "%X", (opcode >> 8) & 0xF);
+            break;
+        case 'Y':
+            n += snprintf(out + n, size - n, "%X", (opcode >> 4) & 0xF);
+            break;
+        case 'K':
+            n += snprintf(out + n, size - n, "0x%02x", opcode & 0xFF);
+            break;
+        case 'n':
+            n += snprintf(out + n, size - n, "%u", opcode & 0xF);
+            break;
+        case 'N':
+            label(out + n, size - n, opcode & 0x0FFF);
+            n += strlen(out + n);
+            break;
+        case 'B':
+            n += snprintf(out + n, size - n, "0x%03x", opcode & 0x0FFF);
+            break;
+        }
+    }
+    out[n] = '\0';
+}
+
+static int compare_addresses(const void *a, const void *b)
+{
+    return *(const uint16_t *)a - *(const uint16_t *)b;
+}
+
+static void print_xrefs(uint16_t address)
+{
+    static uint16_t sources[DIS_MEMORY_SIZE];
+    size_t count = 0;
+    for (size_t i = 0; i < edge_count && count < ARRAY_SIZE(sources); i++)
+    {
+        if (edges[i].to == address && edges[i].flow != FLOW_NEXT && !(edges[i].flow == FLOW_SKIP && !edges[i].taken))
+            sources[count++] = edges[i].from;
+    }
+    qsort(sources, count, sizeof(sources[0]), compare_addresses);
+
+    for (size_t i = 0; i < count; i++)
+    {
+        printf("%s0x%03x", i == 0 ? "  ; from " : ", ", sources[i]);
+    }
+}
+
+static void print_listing(const char *rom_path)
+{
+    printf("; %s, %zu bytes\n", rom_path, rom_end - CHIP8_PROGRAM_START);
+
+    size_t address = CHIP8_PROGRAM_START;
+    while (address < rom_end)
+    {
+        if (address_flags[address] & ADDR_CODE)
+        {
+            char name[32];
+            if (address_flags[address] & ADDR_FUNCTION)
+            {
+                label(name, sizeof(name), address);
+                printf("\n; ---- function %s\n%s:", name, name);
+                print_xrefs(address);
+                printf("\n");
+            }
+            else if (is_block_start(address))
+            {
+                label(name, sizeof(name), address);
+                printf("%s:", name);
+                print_xrefs(address);
+                printf("\n");
+            }
+
+            uint16_t opcode = fetch(address);
+            char text[64];
+            format_instruction(text, sizeof(text), opcode);
+            if (decode(opcode)->flow == FLOW_INDIRECT)
+                printf("    %03zx  %04x  %-24s; indirect, targets unknown\n", address, opcode, text);
+            else
+                printf("    %03zx  %04x  %s\n", address, opcode, text);
+            address += INSTRUCTION_SIZE;
+            continue;
+        }
+
+        // Data runs until the next instruction, 8 bytes per line
+        if (address_flags[address] & ADDR_DATA_REF)
+            printf("data_%03zx:\n", address);
+
+        size_t end = address + 1;
+        while (end < rom_end && end - address < 8
+               && !(address_flags[end] & (ADDR_CODE | ADDR_DATA_REF)))
+            end++;
+
+        printf("    %03zx  db    ", address);
+        for (size_t i = address; i < end; i++)
+        {
+            printf("%s0x%02x", i == address ? "" : ", ", memory[i]);
+        }
+        uint8_t used = 0;
+        for (size_t i = address; coverage_map != NULL && i < end; i++)
+        {
+            used |= coverage_map->flags[i];
+        }
+        if (used & (COVERAGE_SPRITE | COVERAGE_READ | COVERAGE_WRITTEN))
+        {
+            printf("%*s  ;%s%s%s", (int)(8 - (end - address)) * 6, "",
+                   used & COVERAGE_SPRITE ? " sprite" : "", used & COVERAGE_READ ? " read" : "",
+                   used & COVERAGE_WRITTEN ? " written" : "");
+        }
+        printf("\n");
+        address = end;
+    }
+}
+
+static void print_cfg(void)
+{
+    printf("digraph cfg {\n");
+    printf("    node [shape=box fontname=monospace];\n");
+
+    for (size_t entry = 0; entry < DIS_MEMORY_SIZE; entry++)
+    {
+        if (!(address_flags[entry] & ADDR_FUNCTION))
+            continue;
+
+        printf("    subgraph cluster_%03zx {\n        label=\"sub_%03zx\";\n", entry, entry);
+        for (size_t start = 0; start < DIS_MEMORY_SIZE; start++)
+        {
+            if (function_of[start] != entry || !is_block_start(start))
+                continue;
+
+            printf("        b%03zx [label=\"", start);
+            uint16_t address = start;
+            for (;;)
+            {
+                char text[64];
+                format_instruction(text, sizeof(text), fetch(address));
+                printf("%03x  %s\\l", address, text);
+                if (ends_block(address))
+                    break;
+                address += INSTRUCTION_SIZE;
+                if (!(address_flags[address] & ADDR_CODE) || is_block_start(address))
+                    break;
+            }
+            printf("\"];\n");
+        }
+        printf("    }\n");
+    }
+
+    for (size_t i = 0; i < edge_count; i++)
+    {
+        const Edge *edge = &edges[i];
+        if (!(address_flags[edge->to] & ADDR_CODE))
+            continue;
+
+        // Edges leave a block from its last instruction
+        uint16_t from = edge->from;
+        while (!is_block_start(from))
+            from -= INSTRUCTION_SIZE;
+        if (edge->flow == FLOW_NEXT && !is_block_start(edge->to))
+            continue;
+
+        const char *style = "";
+        if (edge->flow == FLOW_CALL)
+            style = " [style=dashed label=call]";
+        else if (edge->flow == FLOW_SKIP)
+            style = edge->taken ? " [label=skip]" : " [label=next]";
+        printf("    b%03x -> b%03x%s;\n", from, edge->to, style);
+    }
+
+    for (size_t address = 0; address < DIS_MEMORY_SIZE; address++)
+    {
+        if ((address_flags[address] & ADDR_CODE) && decode(fetch(address))->flow == FLOW_INDIRECT)
+        {
+            uint16_t from = address;
+            while (!is_block_start(from))
+                from -= INSTRUCTION_SIZE;
+            printf("    indirect_%03zx [shape=diamond label=\"?\"];\n", address);
+            printf("    b%03x -> indirect_%03zx [style=dotted label=\"JP V0\"];\n", from, address);
+        }
+    }
+    printf("}\n");
+}
+
+static void print_call_graph(void)
+{
+    printf("digraph calls {\n");
+    printf("    node [shape=box fontname=monospace];\n");
+    for (size_t entry = 0; entry < DIS_MEMORY_SIZE; entry++)
+    {
+        if (address_flags[entry] & ADDR_FUNCTION)
+            printf("    sub_%03zx;\n", entry);
+    }
+
+    // One edge per caller/callee pair
+    static uint8_t seen[DIS_MEMORY_SIZE][DIS_MEMORY_SIZE / 8];
+    for (size_t i = 0; i < edge_count; i++)
+    {
+        if (edges[i].flow != FLOW_CALL || function_of[edges[i].from] == 0xFFFF)
+            continue;
+
+        uint16_t caller = function_of[edges[i].from];
+        uint16_t callee = edges[i].to;
+        if (seen[caller][callee / 8] & (1U << (callee % 8)))
+            continue;
+        seen[caller][callee / 8] |= 1U << (callee % 8);
+        printf("    sub_%03x -> sub_%03x;\n", caller, callee);
+    }
+
+    for (size_t address = 0; address < DIS_MEMORY_SIZE; address++)
+    {
+        if ((address_flags[address] & ADDR_CODE) && decode(fetch(address))->flow == FLOW_INDIRECT
+            && function_of[address] != 0xFFFF)
+        {
+            printf("    sub_%03x -> indirect_%03zx [style=dotted];\n", function_of[address], address);
+            printf("    indirect_%03zx [shape=diamond label=\"JP V0 @%03zx\"];\n", address, address);
+        }
+    }
+    printf("}\n");
+}
+
+int main(int argc, char **argv)
+{
+    const char *rom_path = NULL;
+    const char *map_path = NULL;
+    enum { OUTPUT_LISTING, OUTPUT_CFG, OUTPUT_CALLS } output = OUTPUT_LISTING;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--map") == 0 && i + 1 < argc)
+            map_path = argv[++i];
+        else if (strcmp(argv[i], "--cfg") == 0)
+            output = OUTPUT_CFG;
+        else if (strcmp(argv[i], "--calls") == 0)
+            output = OUTPUT_CALLS;
+        else
+            rom_path = argv[i];
+    }
+
+    if (rom_path == NULL)
+    {
+        fprintf(stderr, "usage: %s [--map coverage.map] [--cfg | --calls] <rom>\n", argv[0]);
+        return 1;
+    }
+
+    FILE *file = fopen(rom_path, "rb");
+    if (file == NULL)
+    {
+        fprintf(stderr, "Could not open %s\n", rom_path);
+        return 1;
+    }
+    size_t rom_size = fread(memory + CHIP8_PROGRAM_START, 1, DIS_MEMORY_SIZE - CHIP8_PROGRAM_START, file);
+    fclose(file);
+    rom_end = CHIP8_PROGRAM_START + rom_size;
+
+    visit(CHIP8_PROGRAM_START, ADDR_LEADER | ADDR_FUNCTION);
+
+    static CoverageMap map;
+    if (map_path != NULL)
+    {
+        if (!coverage_load_file(&map, map_path))
+            return 1;
+        coverage_map = &map;
+
+        // Executed addresses cover both bytes, so only even offsets from an
+        // instruction already known or the start of a run are entry points
+        for (size_t address = CHIP8_PROGRAM_START; address < DIS_MEMORY_SIZE; address++)
+        {
+            if ((map.flags[address] & COVERAGE_EXECUTED) && !(map.flags[address - 1] & COVERAGE_EXECUTED))
+            {
+                for (size_t a = address; a < DIS_MEMORY_SIZE && (map.flags[a] & COVERAGE_EXECUTED); a += 2)
+                {
+                    visit(a, 0);
+                }
+            }
+        }
+    }
+    traverse();
+    assign_functions();
+
+    if (output == OUTPUT_CFG)
+        print_cfg();
+    else if (output == OUTPUT_CALLS)
+        print_call_graph();
+    else
+        print_listing(rom_path);
+
+    free(edges);
+    return 0;
+}
@@ -0,0 +1,255 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "fork.h"
+#include "statehash.h"
+
+ForkStats fork_stats;
+
+static void *fork_allocate(size_t size)
+{
+    void *block = malloc(size);
+    if (block == NULL)
+    {
+        fprintf(stderr, "ERROR: out of memory while forking machines\n");
+        exit(1);
+    }
+    return block;
+}
+
+static size_t fork_page_count(const Chip8Fork *fork)
+{
+    return ((size_t)fork->address_mask + 1) / FORK_PAGE_SIZE;
+}
+
+void fork_from_machine(Chip8Fork *root, const Chip8 *chip8)
+{
+    memset(root, 0, sizeof(*root));
+    root->address_mask = chip8->address_mask;
+    root->quirks = chip8->quirks;
+    root->vblank = chip8->vblank;
+
+    const uint8_t *memory = CHIP8_MEMORY(chip8);
+    for (size_t i = 0; i < fork_page_count(root); i++)
+    {
+        MemoryPage *page = fork_allocate(sizeof(MemoryPage));
+        page->refcount = 1;
+        for (size_t j = 0; j < FORK_PAGE_CHUNKS; j++)
+        {
+            MemoryChunk *chunk = fork_allocate(sizeof(MemoryChunk));
+            chunk->refcount = 1;
+            memcpy(chunk->bytes, memory + i * FORK_PAGE_SIZE + j * FORK_CHUNK_SIZE, FORK_CHUNK_SIZE);
+            page->chunks[j] = chunk;
+        }
+        root->pages[i] = page;
+    }
+
+    root->display = fork_allocate(sizeof(DisplayBlock));
+    root->display->refcount = 1;
+    memcpy(root->display->pixels, chip8->display, sizeof(chip8->display));
+
+    root->registers = chip8->registers;
+    root->I = chip8->I;
+    root->stack = chip8->stack;
+    root->program_counter = chip8->program_counter;
+    root->delay_timer = chip8->delay_timer;
+    root->sound_timer = chip8->sound_timer;
+    root->display_dirty = chip8->display_dirty;
+    root->keypad = chip8->keypad;
+    root->rng_state = chip8->rng_state;
+    memcpy(root->audio_pattern, chip8->audio_pattern, sizeof(root->audio_pattern));
+    root->pitch = chip8->pitch;
+    root->hires = chip8->hires;
+    root->planes = chip8->planes;
+    memcpy(root->rpl, chip8->rpl, sizeof(root->rpl));
+    root->platform = chip8->platform;
+    root->memory_hash = statehash_memory(memory, chip8_memory_size(chip8));
+    root->display_hash = statehash_display(chip8->display);
+}
+
+void fork_clone(Chip8Fork *child, const Chip8Fork *parent)
+{
+    *child = *parent;
+    for (size_t i = 0; i < fork_page_count(child); i++)
+    {
+        child->pages[i]->refcount++;
+    }
+    child->display->refcount++;
+    fork_stats.forks++;
+}
+
+void fork_release(Chip8Fork *fork)
+{
+    for (size_t i = 0; i < fork_page_count(fork); i++)
+    {
+        MemoryPage *page = fork->pages[i];
+        if (--page->refcount == 0)
+        {
+            for (size_t j = 0; j < FORK_PAGE_CHUNKS; j++)
+            {
+                if (--page->chunks[j]->refcount == 0)
+                    free(page->chunks[j]);
+            }
+            free(page);
+        }
+        fork->pages[i] = NULL;
+    }
+
+    if (--fork->display->refcount == 0)
+        free(fork->display);
+    fork->display = NULL;
+}
+
+void fork_to_machine(const Chip8Fork *fork, Chip8 *chip8)
+{
+    chip8_resize_memory(chip8, (size_t)fork->address_mask + 1);
+    uint8_t *memory = CHIP8_MEMORY(chip8);
+    for (size_t i = 0; i < fork_page_count(fork); i++)
+    {
+        for (size_t j = 0; j < FORK_PAGE_CHUNKS; j++)
+        {
+            memcpy(memory + i * FORK_PAGE_SIZE + j * FORK_CHUNK_SIZE, fork->pages[i]->chunks[j]->bytes,
+                   FORK_CHUNK_SIZE);
+        }
+    }
+    memcpy(chip8->display, fork->display->pixels, sizeof(chip8->display));
+
+    chip8->registers = fork->registers;
+    chip8->I = fork->I;
+    chip8->stack = fork->stack;
+    chip8->program_counter = fork->program_counter;
+    chip8->delay_timer = fork->delay_timer;
+    chip8->sound_timer = fork->sound_timer;
+    chip8->display_dirty = fork->display_dirty;
+    chip8->keypad = fork->keypad;
+    chip8->rng_state = fork->rng_state;
+    memcpy(chip8->audio_pattern, fork->audio_pattern, sizeof(chip8->audio_pattern));
+    chip8->pitch = fork->pitch;
+    chip8->hires = fork->hires;
+    chip8->planes = fork->planes;
+    memcpy(chip8->rpl, fork->rpl, sizeof(chip8->rpl));
+    chip8->platform = fork->platform;
+    chip8->address_mask = fork->address_mask;
+    chip8->quirks = fork->quirks;
+    chip8->vblank = fork->vblank;
+    chip8->memory_hash = fork->memory_hash;
+    chip8->display_hash = fork->display_hash;
+}
+
+uint8_t fork_read(const Chip8Fork *fork, uint16_t address)
+{
+    address &= fork->address_mask;
+    const MemoryPage *page = fork->pages[address / FORK_PAGE_SIZE];
+    return page->chunks[address % FORK_PAGE_SIZE / FORK_CHUNK_SIZE]->bytes[address % FORK_CHUNK_SIZE];
+}
+
+static void fork_write(Chip8Fork *fork, uint16_t address, uint8_t value)
+{
+    address &= fork->address_mask;
+    MemoryPage **page = &fork->pages[address / FORK_PAGE_SIZE];
+
+    if ((*page)->refcount > 1)
+    {
+        // The copy points at the same chunks, the chunks themselves are copied below
+        MemoryPage *copy = fork_allocate(sizeof(MemoryPage));
+        memcpy(copy->chunks, (*page)->chunks, sizeof(copy->chunks));
+        for (size_t j = 0; j < FORK_PAGE_CHUNKS; j++)
+        {
+            copy->chunks[j]->refcount++;
+        }
+        copy->refcount = 1;
+        (*page)->refcount--;
+        *page = copy;
+        fork_stats.page_copies++;
+    }
+
+    MemoryChunk **chunk = &(*page)->chunks[address % FORK_PAGE_SIZE / FORK_CHUNK_SIZE];
+    if ((*chunk)->refcount > 1)
+    {
+        MemoryChunk *copy = fork_allocate(sizeof(MemoryChunk));
+        memcpy(copy->bytes, (*chunk)->bytes, FORK_CHUNK_SIZE);
+        copy->refcount = 1;
+        (*chunk)->refcount--;
+        *chunk = copy;
+        fork_stats.chunk_copies++;
+    }
+
+    uint8_t *byte = &(*chunk)->bytes[address % FORK_CHUNK_SIZE];
+    fork->memory_hash ^= statehash_memory_key(address, *byte) ^ statehash_memory_key(address, value);
+    *byte = value;
+}
+
+static void fork_own_display(Chip8Fork *fork)
+{
+    if (fork->display->refcount > 1)
+    {
+        DisplayBlock *copy = fork_allocate(sizeof(DisplayBlock));
+        memcpy(copy->pixels, fork->display->pixels, sizeof(copy->pixels));
+        copy->refcount = 1;
+        fork->display->refcount--;
+        fork->display = copy;
+        fork_stats.display_copies++;
+    }
+}
+
+#define CHIP8_EXECUTE execute_instruction_fork
+#define CHIP8_MACHINE Chip8Fork
+#define MEM_READ(m, addr) fork_read((m), (addr))
+#define MEM_WRITE(m, addr, value) fork_write((m), (addr), (value))
+#define DISPLAY(m) ((m)->display->pixels)
+#define DISPLAY_WRITE_BEGIN(m) fork_own_display(m)
+#define ROW_FLIPPED(m, plane, y, word, mask) ((m)->display_hash ^= statehash_row_key((plane), (y), (word), (mask)))
+#include "chip8_execute.inc"
+
+Chip8Status fork_step(Chip8Fork *fork)
+{
+    uint16_t opcode = ((uint16_t)fork_read(fork, fork->program_counter) << 8)
+                      | fork_read(fork, fork->program_counter + 1);
+    Chip8Status status = execute_instruction_fork(fork, opcode);
+
+#ifdef CHIP8_HASH_CHECK
+    if (fork_hash(fork) != fork_hash_full(fork))
+    {
+        fprintf(stderr, "ERROR: fork rolling hash diverged after PC=0x%04x\n", fork->program_counter);
+        exit(1);
+    }
+#endif
+    return status;
+}
+
+uint64_t fork_hash(const Chip8Fork *fork)
+{
+    return fork->memory_hash ^ fork->display_hash
+           ^ statehash_registers(&fork->registers, fork->I, &fork->stack, fork->program_counter,
+                                 fork->delay_timer, fork->sound_timer, fork->rng_state)
+           ^ statehash_extensions(fork->hires, fork->planes, fork->vblank, fork->rpl,
+                                  fork->audio_pattern, fork->pitch);
+}
+
+uint64_t fork_hash_full(const Chip8Fork *fork)
+{
+    uint64_t memory_hash = 0;
+    for (size_t address = 0; address <= fork->address_mask; address++)
+    {
+        memory_hash ^= statehash_memory_key(address, fork_read(fork, address));
+    }
+
+    return memory_hash ^ statehash_display(fork->display->pixels)
+           ^ statehash_registers(&fork->registers, fork->I, &fork->stack, fork->program_counter,
+                                 fork->delay_timer, fork->sound_timer, fork->rng_state)
+           ^ statehash_extensions(fork->hires, fork->planes, fork->vblank, fork->rpl,
+                                  fork->audio_pattern, fork->pitch);
+}
+
+void fork_tick_timers(Chip8Fork *fork)
+{
+    if (fork->delay_timer > 0)
+        fork->delay_timer--;
+
+    if (fork->sound_timer > 0)
+        fork->sound_timer--;
+
+    if (fork->quirks & CHIP8_QUIRK_DISPLAY_WAIT)
+        fork->vblank = true;
+}
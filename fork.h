@@ -0,0 +1,103 @@
+#ifndef FORK_H
+#define FORK_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "chip8.h"
+
+// Copy-on-write machines for state-space search. Guest memory is split into
+// refcounted chunks shared between a parent and all of its children, a chunk is
+// only copied the first time FX33, FX55 or 5XY2 writes into it. The chunks are
+// found through refcounted pages of 4 KB each, shared and copied the same way, so a
+// fork holds one pointer per 4 KB and classic machines only have the first page.
+// The display is shared too and copied on the first instruction that changes it.
+//
+// Refcounts are not atomic, keep each family of forks on one thread
+
+#define FORK_CHUNK_SIZE (256U)
+#define FORK_PAGE_SIZE (CHIP8_CLASSIC_MEMORY_SIZE)
+#define FORK_PAGE_CHUNKS (FORK_PAGE_SIZE / FORK_CHUNK_SIZE)
+// Only the pages covering the platform's memory exist, the rest stay NULL
+#define FORK_PAGE_COUNT (CHIP8_MEMORY_SIZE / FORK_PAGE_SIZE)
+
+typedef struct
+{
+    uint32_t refcount;
+    uint8_t bytes[FORK_CHUNK_SIZE];
+} MemoryChunk;
+
+// A chunk's refcount counts the pages pointing at it, not the forks
+typedef struct
+{
+    uint32_t refcount;
+    MemoryChunk *chunks[FORK_PAGE_CHUNKS];
+} MemoryPage;
+
+typedef struct
+{
+    uint32_t refcount;
+    Chip8Display pixels;
+} DisplayBlock;
+
+// Same register fields as Chip8, with memory and display behind shared pointers
+typedef struct
+{
+    MemoryPage *pages[FORK_PAGE_COUNT];
+    DisplayBlock *display;
+    Registers registers;
+    uint16_t I;
+    Stack stack;
+    uint16_t program_counter;
+    uint16_t delay_timer;
+    uint16_t sound_timer;
+    bool display_dirty;
+    uint16_t keypad;
+    uint32_t rng_state;
+    uint8_t audio_pattern[CHIP8_AUDIO_PATTERN_SIZE];
+    uint8_t pitch;
+    bool hires;
+    uint8_t planes;
+    uint8_t rpl[CHIP8_FLAG_REGISTER_COUNT];
+    Chip8Platform platform;
+    uint16_t address_mask;
+    uint8_t quirks;
+    bool vblank;
+    // Forks always keep their rolling hashes up to date, see statehash.h
+    uint64_t memory_hash;
+    uint64_t display_hash;
+} Chip8Fork;
+
+typedef struct
+{
+    uint64_t forks;
+    uint64_t page_copies;
+    uint64_t chunk_copies;
+    uint64_t display_copies;
+} ForkStats;
+
+extern ForkStats fork_stats;
+
+// Builds the root of a fork tree from a flat machine, this is the only full copy
+void fork_from_machine(Chip8Fork *root, const Chip8 *chip8);
+
+// Makes child share everything with parent, costs sizeof(Chip8Fork) and no allocation
+void fork_clone(Chip8Fork *child, const Chip8Fork *parent);
+
+// Drops this fork's references, chunks go away with the last fork using them
+void fork_release(Chip8Fork *fork);
+
+// chip8 has to be initialized or zeroed, its memory is resized to the fork's
+void fork_to_machine(const Chip8Fork *fork, Chip8 *chip8);
+
+uint8_t fork_read(const Chip8Fork *fork, uint16_t address);
+Chip8Status execute_instruction_fork(Chip8Fork *fork, uint16_t opcode);
+Chip8Status fork_step(Chip8Fork *fork);
+void fork_tick_timers(Chip8Fork *fork);
+
+// O(1) state hash for deduplication, matches chip8_hash of the same machine
+uint64_t fork_hash(const Chip8Fork *fork);
+uint64_t fork_hash_full(const Chip8Fork *fork);
+
+#endif
@@ -0,0 +1,148 @@
+// Fuzz target: the first input byte picks the platform, the second the quirks, the rest
+// is the ROM. Each run starts from a copy of a pristine machine per platform built once,
+// so resetting never touches main or set_rom.
+//
+//   libFuzzer: make fuzz && ./chip8-fuzz corpus/
+//   AFL++:     make fuzz-afl && afl-fuzz -i roms -o findings -- ./chip8-fuzz-afl
+//   no fuzzer: make fuzz-standalone && ./chip8-fuzz-standalone --bench 100000
+//
+// Plain ROMs still work as seeds, their first two bytes just pick a platform and quirks
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "chip8.h"
+#include "host_time.h"
+
+// Instructions per input (override with -DFUZZ_CYCLES=n), and how many run between timer ticks
+#ifndef FUZZ_CYCLES
+#define FUZZ_CYCLES (1000U)
+#endif
+#define FUZZ_INSTRUCTIONS_PER_FRAME (15U)
+
+#define FUZZ_HEADER_SIZE (2U)
+#define FUZZ_MAX_INPUT_SIZE (FUZZ_HEADER_SIZE + CHIP8_MEMORY_SIZE - CHIP8_PROGRAM_START)
+
+static Chip8 pristine[CHIP8_PLATFORM_COUNT];
+static bool pristine_ready = false;
+// One machine per platform, so switching platforms between runs never reallocates memory
+static Chip8 machines[CHIP8_PLATFORM_COUNT];
+
+// NULL when the input is too short to pick a platform and quirks
+static Chip8 *run_input(const uint8_t *data, size_t size)
+{
+    if (!pristine_ready)
+    {
+        for (int platform = 0; platform < CHIP8_PLATFORM_COUNT; platform++)
+        {
+            chip8_init(&pristine[platform], CHIP8_DEFAULT_SEED);
+            chip8_set_platform(&pristine[platform], platform);
+        }
+        pristine_ready = true;
+    }
+    if (size < FUZZ_HEADER_SIZE)
+        return NULL;
+
+    Chip8Platform platform = data[0] % CHIP8_PLATFORM_COUNT;
+    Chip8 *machine = &machines[platform];
+    chip8_copy(machine, &pristine[platform]);
+    chip8_set_quirks(machine, data[1] & (CHIP8_QUIRK_COMBINATIONS - 1));
+
+    size_t rom_size = size - FUZZ_HEADER_SIZE;
+    size_t max_rom_size = chip8_memory_size(machine) - CHIP8_PROGRAM_START;
+    memcpy(CHIP8_MEMORY(machine) + CHIP8_PROGRAM_START, data + FUZZ_HEADER_SIZE,
+           rom_size < max_rom_size ? rom_size : max_rom_size);
+
+    for (uint32_t cycle = 0; cycle < FUZZ_CYCLES; cycle++)
+    {
+        if (cycle % FUZZ_INSTRUCTIONS_PER_FRAME == 0)
+        {
+            chip8_tick_timers(machine);
+            // Alternate between all keys and none so both sides of EX9E/EXA1 get taken
+            machine->keypad = ~machine->keypad;
+        }
+
+        if (chip8_step(machine) != CHIP8_OK)
+            break;
+    }
+    return machine;
+}
+
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size)
+{
+    run_input(data, size);
+    return 0;
+}
+
+#ifdef FUZZ_STANDALONE
+
+#ifdef __AFL_FUZZ_TESTCASE_LEN
+__AFL_FUZZ_INIT();
+#endif
+
+static void run_file(const char *path)
+{
+    static uint8_t buffer[FUZZ_MAX_INPUT_SIZE];
+    FILE *file = fopen(path, "rb");
+    if (file == NULL)
+    {
+        fprintf(stderr, "Could not open %s\n", path);
+        return;
+    }
+    size_t size = fread(buffer, 1, sizeof(buffer), file);
+    fclose(file);
+
+    const Chip8 *machine = run_input(buffer, size);
+    if (machine == NULL)
+        printf("%s: too short, needs a platform and a quirks byte\n", path);
+    else
+        printf("%s: %s, stopped at PC=0x%03x\n", path, chip8_platform_name(machine->platform),
+               machine->program_counter);
+}
+
+// Random inputs of random length, reports how many resets+runs a core manages per second
+static void bench(uint32_t runs)
+{
+    static uint8_t buffer[FUZZ_MAX_INPUT_SIZE];
+    uint32_t rng_state = CHIP8_DEFAULT_SEED;
+
+    uint64_t start_ns = host_time_ns();
+    for (uint32_t run = 0; run < runs; run++)
+    {
+        size_t size = 2 + chip8_random_next(&rng_state) * 4;
+        for (size_t i = 0; i < size; i++)
+        {
+            buffer[i] = chip8_random_next(&rng_state);
+        }
+        LLVMFuzzerTestOneInput(buffer, size);
+    }
+    double seconds = (host_time_ns() - start_ns) / 1e9;
+    printf("%u execs in %.3f s, %.0f execs/s\n", runs, seconds, runs / seconds);
+}
+
+int main(int argc, char **argv)
+{
+#ifdef __AFL_FUZZ_TESTCASE_LEN
+    __AFL_INIT();
+    const uint8_t *data = __AFL_FUZZ_TESTCASE_BUF;
+    while (__AFL_LOOP(100000))
+    {
+        LLVMFuzzerTestOneInput(data, __AFL_FUZZ_TESTCASE_LEN);
+    }
+#else
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--bench") == 0 && i + 1 < argc)
+            bench((uint32_t)strtoul(argv[++i], NULL, 0));
+        else
+            run_file(argv[i]);
+    }
+#endif
+    return 0;
+}
+
+#endif
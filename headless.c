@@ -0,0 +1,521 @@
+// Command line front end for running the core without a window, audio or pacing
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "buzzer.h"
+#include "chip8.h"
+#include "conformance.h"
+#include "coverage.h"
+#include "diffcheck.h"
+#include "host_time.h"
+#include "movie.h"
+#include "romdb.h"
+#include "wav.h"
+
+static bool read_file(const char *path, uint8_t *buffer, size_t capacity, size_t *size)
+{
+    FILE *file = fopen(path, "rb");
+    if (file == NULL)
+    {
+        fprintf(stderr, "Could not open %s\n", path);
+        return false;
+    }
+
+    *size = fread(buffer, 1, capacity, file);
+    bool too_big = fgetc(file) != EOF;
+    fclose(file);
+
+    if (too_big)
+    {
+        fprintf(stderr, "%s is larger than %zu bytes\n", path, capacity);
+        return false;
+    }
+    return true;
+}
+
+static int replay(const char *movie_path, const char *rom_path)
+{
+    uint8_t rom[CHIP8_MEMORY_SIZE - CHIP8_PROGRAM_START];
+    size_t rom_size;
+    if (!read_file(rom_path, rom, sizeof(rom), &rom_size))
+        return 1;
+
+    Movie movie;
+    if (!movie_load_file(&movie, movie_path))
+        return 1;
+
+    Chip8 chip8 = { 0 };
+    MovieReplayResult result;
+    bool ok = movie_replay(&movie, rom, rom_size, &chip8, &result);
+    chip8_free(&chip8);
+
+    if (result.frames > 0)
+    {
+        double seconds = result.elapsed_ns / 1e9;
+        printf("%u frames, %llu instructions in %.3f ms", result.frames,
+               (unsigned long long)result.instructions, seconds * 1e3);
+        if (seconds > 0)
+            printf(" (%.1f M instructions/s, %.0fx real time)", result.instructions / seconds / 1e6,
+                   result.frames / 60.0 / seconds);
+        printf("\n");
+        printf("final hash %016llx, recorded %016llx: %s\n", (unsigned long long)result.final_hash,
+               (unsigned long long)movie.final_hash, ok ? "match" : "MISMATCH");
+    }
+
+    movie_free(&movie);
+    return ok ? 0 : 1;
+}
+
+typedef struct
+{
+    const char *rom_path;
+    const ExecutionEngine *engine;
+    bool ok;
+    char *report;
+    size_t report_size;
+    DiffCheckResult result;
+} DiffJob;
+
+typedef struct
+{
+    DiffJob *jobs;
+    size_t job_count;
+    size_t next_job;
+    pthread_mutex_t lock;
+    DiffCheckConfig config;
+} DiffQueue;
+
+static void run_diff_job(DiffJob *job, const DiffCheckConfig *config)
+{
+    FILE *report = open_memstream(&job->report, &job->report_size);
+    if (report == NULL)
+    {
+        fprintf(stderr, "ERROR: could not create report buffer\n");
+        exit(1);
+    }
+
+    uint8_t rom[CHIP8_MEMORY_SIZE - CHIP8_PROGRAM_START];
+    size_t rom_size;
+    if (!read_file(job->rom_path, rom, sizeof(rom), &rom_size))
+        job->ok = false;
+    else
+        job->ok = diffcheck_run(job->engine, rom, rom_size, config, report, &job->result);
+
+    fclose(report);
+}
+
+static void *diff_worker(void *arg)
+{
+    DiffQueue *queue = arg;
+    for (;;)
+    {
+        pthread_mutex_lock(&queue->lock);
+        size_t index = queue->next_job++;
+        pthread_mutex_unlock(&queue->lock);
+
+        if (index >= queue->job_count)
+            return NULL;
+        run_diff_job(&queue->jobs[index], &queue->config);
+    }
+}
+
+// Every ROM against every selected engine, one job per pair spread over all cores
+static int diff(int argc, char **argv)
+{
+    DiffQueue queue = {
+        .config = {
+            .frames = 3600,
+            .instructions_per_frame = 15,
+            .interval = 1,
+            .seed = CHIP8_DEFAULT_SEED,
+            .platform = CHIP8_PLATFORM_CHIP8,
+        },
+    };
+    const ExecutionEngine *selected = NULL;
+    long threads = sysconf(_SC_NPROCESSORS_ONLN);
+
+    const char **roms = calloc(argc, sizeof(char *));
+    size_t rom_count = 0;
+    for (int i = 0; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--engine") == 0 && i + 1 < argc)
+        {
+            selected = diffcheck_find_engine(argv[++i]);
+            if (selected == NULL)
+            {
+                fprintf(stderr, "Unknown engine %s\n", argv[i]);
+                return 1;
+            }
+        }
+        else if (strcmp(argv[i], "--frames") == 0 && i + 1 < argc)
+        {
+            queue.config.frames = (uint32_t)strtoul(argv[++i], NULL, 0);
+        }
+        else if (strcmp(argv[i], "--ipf") == 0 && i + 1 < argc)
+        {
+            queue.config.instructions_per_frame = (uint32_t)strtoul(argv[++i], NULL, 0);
+        }
+        else if (strcmp(argv[i], "--interval") == 0 && i + 1 < argc)
+        {
+            queue.config.interval = (uint32_t)strtoul(argv[++i], NULL, 0);
+        }
+        else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc)
+        {
+            queue.config.seed = (uint32_t)strtoul(argv[++i], NULL, 0);
+        }
+        else if (strcmp(argv[i], "--platform") == 0 && i + 1 < argc)
+        {
+            if (!chip8_parse_platform(argv[++i], &queue.config.platform))
+            {
+                fprintf(stderr, "Unknown platform %s\n", argv[i]);
+                return 1;
+            }
+        }
+        else if (strcmp(argv[i], "--quirks") == 0 && i + 1 < argc)
+        {
+            if (!chip8_parse_quirks(argv[++i], &queue.config.quirks))
+            {
+                fprintf(stderr, "Unknown quirk profile %s\n", argv[i]);
+                return 1;
+            }
+        }
+        else if (strcmp(argv[i], "--jobs") == 0 && i + 1 < argc)
+        {
+            threads = strtol(argv[++i], NULL, 0);
+        }
+        else
+        {
+            roms[rom_count++] = argv[i];
+        }
+    }
+
+    if (queue.config.interval == 0)
+        queue.config.interval = 1;
+    if (threads < 1)
+        threads = 1;
+
+    size_t engine_count = 0;
+    while (diffcheck_engines[engine_count] != NULL)
+        engine_count++;
+
+    queue.jobs = calloc(rom_count * engine_count, sizeof(DiffJob));
+    for (size_t r = 0; r < rom_count; r++)
+    {
+        for (size_t e = 0; e < engine_count; e++)
+        {
+            if (selected != NULL && diffcheck_engines[e] != selected)
+                continue;
+            queue.jobs[queue.job_count].rom_path = roms[r];
+            queue.jobs[queue.job_count].engine = diffcheck_engines[e];
+            queue.job_count++;
+        }
+    }
+
+    if ((size_t)threads > queue.job_count)
+        threads = queue.job_count;
+
+    pthread_mutex_init(&queue.lock, NULL);
+    pthread_t *workers = calloc(threads, sizeof(pthread_t));
+    for (long i = 0; i < threads; i++)
+    {
+        pthread_create(&workers[i], NULL, diff_worker, &queue);
+    }
+    for (long i = 0; i < threads; i++)
+    {
+        pthread_join(workers[i], NULL);
+    }
+    pthread_mutex_destroy(&queue.lock);
+
+    size_t failures = 0;
+    for (size_t i = 0; i < queue.job_count; i++)
+    {
+        DiffJob *job = &queue.jobs[i];
+        printf("%-8s %-8s %s (%u frames, %.1f ms)\n", job->ok ? "ok" : "FAIL", job->engine->name,
+               job->rom_path, job->result.frames_checked, job->result.elapsed_ns / 1e6);
+        fwrite(job->report, 1, job->report_size, stdout);
+        free(job->report);
+        failures += !job->ok;
+    }
+    printf("%zu/%zu checks passed on %ld threads\n", queue.job_count - failures, queue.job_count, threads);
+
+    free(workers);
+    free(queue.jobs);
+    free(roms);
+    return failures == 0 ? 0 : 1;
+}
+
+static int conformance(int argc, char **argv)
+{
+    bool update = false;
+    const char *golden_path = CONFORMANCE_GOLDEN_FILE;
+    const char *rom_dir = "roms";
+    for (int i = 0; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--update") == 0)
+            update = true;
+        else if (strcmp(argv[i], "--goldens") == 0 && i + 1 < argc)
+            golden_path = argv[++i];
+        else if (strcmp(argv[i], "--roms") == 0 && i + 1 < argc)
+            rom_dir = argv[++i];
+    }
+
+    return conformance_run_suite(rom_dir, golden_path, update, stdout) ? 0 : 1;
+}
+
+// Runs a ROM, driven by a movie when one is given, and writes its code/data map
+static int coverage(int argc, char **argv)
+{
+    const char *rom_path = argv[0];
+    const char *map_path = argv[1];
+    const char *movie_path = NULL;
+    uint32_t frames = 3600;
+    uint32_t instructions_per_frame = 15;
+    for (int i = 2; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--movie") == 0 && i + 1 < argc)
+            movie_path = argv[++i];
+        else if (strcmp(argv[i], "--frames") == 0 && i + 1 < argc)
+            frames = (uint32_t)strtoul(argv[++i], NULL, 0);
+        else if (strcmp(argv[i], "--ipf") == 0 && i + 1 < argc)
+            instructions_per_frame = (uint32_t)strtoul(argv[++i], NULL, 0);
+    }
+
+    uint8_t rom[CHIP8_MEMORY_SIZE - CHIP8_PROGRAM_START];
+    size_t rom_size;
+    if (!read_file(rom_path, rom, sizeof(rom), &rom_size))
+        return 1;
+
+    Movie movie = { .seed = CHIP8_DEFAULT_SEED };
+    if (movie_path != NULL)
+    {
+        if (!movie_load_file(&movie, movie_path))
+            return 1;
+        frames = movie.frame_count;
+        instructions_per_frame = movie.instructions_per_frame;
+    }
+
+    Chip8 chip8;
+    chip8_init(&chip8, movie.seed);
+    chip8_set_platform(&chip8, movie.platform);
+    chip8_set_quirks(&chip8, movie.quirks);
+    if (!chip8_load_program(&chip8, rom, rom_size))
+        return 1;
+
+    static CoverageMap map;
+    coverage_reset(&map);
+
+    Chip8Status status = CHIP8_OK;
+    size_t run = 0;
+    uint32_t run_frames = 0;
+    for (uint32_t frame = 0; frame < frames && status == CHIP8_OK; frame++)
+    {
+        if (run < movie.run_count)
+        {
+            chip8.keypad = movie.runs[run].keypad;
+            if (++run_frames == movie.runs[run].frames)
+            {
+                run++;
+                run_frames = 0;
+            }
+        }
+
+        chip8_tick_timers(&chip8);
+        for (uint32_t step = 0; step < instructions_per_frame && status == CHIP8_OK; step++)
+        {
+            status = chip8_step_coverage(&chip8, &map);
+        }
+    }
+    movie_free(&movie);
+    chip8_free(&chip8);
+
+    if (status != CHIP8_OK)
+        printf("Stopped early: %s at PC=0x%03x\n", chip8_status_name(status), chip8.program_counter);
+
+    size_t executed = 0;
+    for (size_t i = 0; i < CHIP8_MEMORY_SIZE; i++)
+    {
+        executed += (map.flags[i] & COVERAGE_EXECUTED) != 0;
+    }
+    printf("%zu instructions of %s executed\n", executed, rom_path);
+
+    return coverage_save_file(&map, rom_path, rom_size, map_path) ? 0 : 1;
+}
+
+// Renders the buzzer against emulated time, one tick's worth of samples per frame,
+// so the WAV comes out correctly timed no matter how fast the run was
+static int audio(int argc, char **argv)
+{
+    const char *rom_path = argv[0];
+    const char *wav_path = argv[1];
+    const char *movie_path = NULL;
+    uint32_t frames = 3600;
+    uint32_t instructions_per_frame = 15;
+    uint32_t sample_rate = BUZZER_SAMPLE_RATE;
+    for (int i = 2; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--movie") == 0 && i + 1 < argc)
+            movie_path = argv[++i];
+        else if (strcmp(argv[i], "--frames") == 0 && i + 1 < argc)
+            frames = (uint32_t)strtoul(argv[++i], NULL, 0);
+        else if (strcmp(argv[i], "--ipf") == 0 && i + 1 < argc)
+            instructions_per_frame = (uint32_t)strtoul(argv[++i], NULL, 0);
+        else if (strcmp(argv[i], "--rate") == 0 && i + 1 < argc)
+            sample_rate = (uint32_t)strtoul(argv[++i], NULL, 0);
+    }
+    if (sample_rate < EMULATION_HZ)
+    {
+        fprintf(stderr, "Sample rate %u is too low\n", sample_rate);
+        return 1;
+    }
+
+    uint8_t rom[CHIP8_MEMORY_SIZE - CHIP8_PROGRAM_START];
+    size_t rom_size;
+    if (!read_file(rom_path, rom, sizeof(rom), &rom_size))
+        return 1;
+
+    Movie movie = { .seed = CHIP8_DEFAULT_SEED };
+    if (movie_path != NULL)
+    {
+        if (!movie_load_file(&movie, movie_path))
+            return 1;
+        frames = movie.frame_count;
+        instructions_per_frame = movie.instructions_per_frame;
+    }
+
+    Chip8 chip8;
+    chip8_init(&chip8, movie.seed);
+    chip8_set_platform(&chip8, movie.platform);
+    chip8_set_quirks(&chip8, movie.quirks);
+    if (!chip8_load_program(&chip8, rom, rom_size))
+        return 1;
+
+    WavWriter wav;
+    if (!wav_open(&wav, wav_path, sample_rate))
+        return 1;
+
+    static Buzzer buzzer;
+    buzzer_init(&buzzer, sample_rate);
+    int16_t *samples = malloc(BUZZER_MAX_TICK_SAMPLES(sample_rate) * sizeof(int16_t));
+    if (samples == NULL)
+        return 1;
+
+    Chip8Status status = CHIP8_OK;
+    size_t run = 0;
+    uint32_t run_frames = 0;
+    uint32_t beep_frames = 0;
+    bool written = true;
+    uint64_t start_ns = host_time_ns();
+    for (uint32_t frame = 0; frame < frames && status == CHIP8_OK && written; frame++)
+    {
+        if (run < movie.run_count)
+        {
+            chip8.keypad = movie.runs[run].keypad;
+            if (++run_frames == movie.runs[run].frames)
+            {
+                run++;
+                run_frames = 0;
+            }
+        }
+
+        chip8_tick_timers(&chip8);
+        for (uint32_t step = 0; step < instructions_per_frame && status == CHIP8_OK; step++)
+        {
+            status = chip8_step(&chip8);
+        }
+
+        beep_frames += chip8.sound_timer > 0;
+        buzzer_update(&buzzer, &chip8);
+        size_t count = buzzer_tick_samples(&buzzer, frame);
+        buzzer_render(&buzzer, samples, count);
+        written = wav_write(&wav, samples, count);
+    }
+    uint64_t elapsed_ns = host_time_ns() - start_ns;
+    movie_free(&movie);
+    chip8_free(&chip8);
+    free(samples);
+
+    if (status != CHIP8_OK)
+        printf("Stopped early: %s at PC=0x%03x\n", chip8_status_name(status), chip8.program_counter);
+
+    double seconds = (double)wav.frames / sample_rate;
+    if (!wav_close(&wav) || !written)
+    {
+        fprintf(stderr, "Could not write %s\n", wav_path);
+        return 1;
+    }
+    printf("Wrote %.2f s of audio (%u frames with the sound timer running) to %s in %.1f ms\n",
+           seconds, beep_frames, wav_path, elapsed_ns / 1e6);
+    return 0;
+}
+
+// What the index says about each ROM, to check a freshly generated one
+static int romdb(int argc, char **argv)
+{
+    RomDb db;
+    if (!romdb_load_file(&db, argv[0]))
+        return 1;
+    printf("%zu ROMs in %s\n", db.entry_count, argv[0]);
+
+    static uint8_t rom[CHIP8_MEMORY_SIZE - CHIP8_PROGRAM_START];
+    int failed = 0;
+    for (int i = 1; i < argc; i++)
+    {
+        size_t rom_size;
+        if (!read_file(argv[i], rom, sizeof(rom), &rom_size))
+        {
+            failed = 1;
+            continue;
+        }
+
+        RomInfo info;
+        uint64_t key = romdb_key(rom, rom_size);
+        if (!romdb_lookup(&db, rom, rom_size, &info))
+        {
+            printf("%016llx %s: not found\n", (unsigned long long)key, argv[i]);
+            continue;
+        }
+
+        const char *quirks = chip8_quirks_name(info.quirks);
+        printf("%016llx %s: %s, quirks %s (0x%02x), %u instructions per frame\n", (unsigned long long)key,
+               argv[i], chip8_platform_name(info.platform), quirks ? quirks : "custom", info.quirks,
+               info.instructions_per_frame);
+    }
+
+    romdb_free(&db);
+    return failed;
+}
+
+static void usage(const char *program)
+{
+    fprintf(stderr, "usage: %s replay <movie> <rom>\n", program);
+    fprintf(stderr, "       %s diff [--engine name] [--frames n] [--ipf n] [--interval frames]\n"
+                    "            [--seed n] [--platform name] [--quirks profile] [--jobs n] <rom>...\n", program);
+    fprintf(stderr, "       %s conformance [--update] [--goldens file] [--roms dir]\n", program);
+    fprintf(stderr, "       %s coverage <rom> <map> [--movie file] [--frames n] [--ipf n]\n", program);
+    fprintf(stderr, "       %s audio <rom> <wav> [--movie file] [--frames n] [--ipf n] [--rate hz]\n", program);
+    fprintf(stderr, "       %s romdb <index> <rom>...\n", program);
+}
+
+int main(int argc, char **argv)
+{
+    if (argc == 4 && strcmp(argv[1], "replay") == 0)
+        return replay(argv[2], argv[3]);
+    if (argc >= 3 && strcmp(argv[1], "diff") == 0)
+        return diff(argc - 2, argv + 2);
+    if (argc >= 4 && strcmp(argv[1], "coverage") == 0)
+        return coverage(argc - 2, argv + 2);
+    if (argc >= 4 && strcmp(argv[1], "audio") == 0)
+        return audio(argc - 2, argv + 2);
+    if (argc >= 2 && strcmp(argv[1], "conformance") == 0)
+        return conformance(argc - 2, argv + 2);
+    if (argc >= 3 && strcmp(argv[1], "romdb") == 0)
+        return romdb(argc - 2, argv + 2);
+
+    usage(argv[0]);
+    return 1;
+}
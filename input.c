@@ -0,0 +1,103 @@
+#include <stdio.h>
+
+#include "host_time.h"
+#include "input.h"
+#include "pacing.h"
+
+typedef struct
+{
+    uint64_t host_ns;
+    uint64_t position;
+    uint16_t keypad;
+} InputEvent;
+
+InputStats input_stats;
+
+static InputEvent queue[INPUT_QUEUE_SIZE];
+static size_t queue_first;
+static size_t queue_count;
+static uint16_t sampled_keypad;
+
+void input_sample(uint16_t keypad, uint64_t host_ns)
+{
+    if (keypad == sampled_keypad)
+        return;
+    sampled_keypad = keypad;
+
+    if (queue_count == INPUT_QUEUE_SIZE)
+    {
+        queue_first = (queue_first + 1) % INPUT_QUEUE_SIZE;
+        queue_count--;
+        input_stats.dropped++;
+    }
+
+    InputEvent *event = &queue[(queue_first + queue_count) % INPUT_QUEUE_SIZE];
+    event->host_ns = host_ns;
+    event->position = pacing_emulated_position(host_ns);
+    event->keypad = keypad;
+    queue_count++;
+}
+
+uint16_t input_latest_keypad(void)
+{
+    return sampled_keypad;
+}
+
+uint32_t input_next_instruction(uint64_t tick, uint32_t instructions_per_tick)
+{
+    if (queue_count == 0)
+        return UINT32_MAX;
+
+    uint64_t position = queue[queue_first].position;
+    uint64_t tick_start = tick << PACING_TICK_FRACTION_BITS;
+    if (position <= tick_start)
+        return 0;
+    if (position >= tick_start + (1ULL << PACING_TICK_FRACTION_BITS))
+        return UINT32_MAX;
+
+    return (uint32_t)(((position - tick_start) * instructions_per_tick) >> PACING_TICK_FRACTION_BITS);
+}
+
+static const InputEvent *input_pop(Chip8 *chip8)
+{
+    const InputEvent *event = &queue[queue_first];
+    chip8->keypad = event->keypad;
+    queue_first = (queue_first + 1) % INPUT_QUEUE_SIZE;
+    queue_count--;
+    return event;
+}
+
+void input_apply(Chip8 *chip8, uint32_t instruction)
+{
+    if (queue_count == 0)
+        return;
+
+    const InputEvent *event = input_pop(chip8);
+    uint64_t now = host_time_ns();
+    uint64_t latency_ns = now > event->host_ns ? now - event->host_ns : 0;
+    input_stats.events++;
+    input_stats.latency_ns_total += latency_ns;
+    if (latency_ns > input_stats.latency_ns_max)
+        input_stats.latency_ns_max = latency_ns;
+    if (instruction > 0)
+        input_stats.mid_tick++;
+}
+
+void input_flush(Chip8 *chip8)
+{
+    while (queue_count > 0)
+        input_pop(chip8);
+}
+
+void input_print_stats(void)
+{
+    if (input_stats.events == 0)
+        return;
+
+    printf("Input: %llu key changes, latency %.2f ms avg %.2f ms max, %llu applied mid-tick, %llu dropped\n",
+           (unsigned long long)input_stats.events,
+           input_stats.latency_ns_total / 1e6 / input_stats.events,
+           input_stats.latency_ns_max / 1e6,
+           (unsigned long long)input_stats.mid_tick,
+           (unsigned long long)input_stats.dropped);
+}
@@ -0,0 +1,47 @@
+#ifndef INPUT_H
+#define INPUT_H
+
+#include <stdint.h>
+
+#include "chip8.h"
+
+// Timestamped keypad changes. The frontend samples the keyboard whenever it can
+// (every frame and while pacing waits between frames), each change is placed on
+// the emulated clock and handed to the guest at the instruction the CPU had
+// reached at that moment, instead of at the next frame boundary
+
+#define INPUT_QUEUE_SIZE (64U)
+
+typedef struct
+{
+    uint64_t events;
+    uint64_t latency_ns_total;
+    uint64_t latency_ns_max;
+    // Changes applied between two instructions of a tick rather than at its start
+    uint64_t mid_tick;
+    // Oldest changes thrown away because the queue filled up (the machine was paused)
+    uint64_t dropped;
+} InputStats;
+
+extern InputStats input_stats;
+
+// Queues keypad if it differs from the last sample
+void input_sample(uint16_t keypad, uint64_t host_ns);
+
+// Newest sampled keypad, the best guess for input that has not happened yet
+uint16_t input_latest_keypad(void);
+
+// Instruction of tick the oldest queued change belongs in front of, 0 when it is
+// already overdue and UINT32_MAX when there is none up to the end of the tick
+uint32_t input_next_instruction(uint64_t tick, uint32_t instructions_per_tick);
+
+// Hands the oldest queued change to the machine and records its latency
+void input_apply(Chip8 *chip8, uint32_t instruction);
+
+// Hands over every queued change at once without counting it, for when the
+// machine was not running (paused, rewinding)
+void input_flush(Chip8 *chip8);
+
+void input_print_stats(void);
+
+#endif
@@ -3,6 +3,7 @@
 // - make an equivalent menu for native implementation
 
 
+#include <fcntl.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdint.h>
@@ -12,6 +13,23 @@
 
 #include <raylib.h>
 
+#include "buzzer.h"
+#include "chip8.h"
+#include "coverage.h"
+#include "debugger.h"
+#include "host_time.h"
+#include "input.h"
+#include "movie.h"
+#include "overlay.h"
+#include "pacing.h"
+#include "rewind.h"
+#include "romdb.h"
+#include "savestate.h"
+#include "statehash.h"
+#include "timetravel.h"
+#include "trace.h"
+#include "wav.h"
+
 #if defined(PLATFORM_WEB)
     #include <emscripten/emscripten.h>
     #define EMSCRIPTEN_API extern EMSCRIPTEN_KEEPALIVE
@@ -19,21 +37,6 @@
     #define EMSCRIPTEN_API
 #endif
 
-// #define DEBUG
-
-// TODO error logging as well
-#ifdef DEBUG
-#define DEBUG_PRINT printf
-#else
-#define DEBUG_PRINT
-#endif
-
-#define ARRAY_SIZE(arr) (sizeof(arr)/sizeof(arr[0]))
-
-#define CHIP8_MEMORY_SIZE 4096U
-#define CHIP8_STACK_SIZE 16U
-#define MAX_PROGRAM_SIZE 2 * 1028
-
 #define BYTE_TO_BINARY_PATTERN "%c%c%c%c%c%c%c%c"
 #define BYTE_TO_BINARY(byte)  \
   ((byte) & 0x80 ? '1' : '0'), \
@@ -45,121 +48,6 @@
   ((byte) & 0x02 ? '1' : '0'), \
   ((byte) & 0x01 ? '1' : '0') 
 
-#define CLEAR_SCREEN             (0x00E0)
-#define RETURN_SUBROUTINE        (0x00EE)
-#define JUMP_ADDR                (0x1000)
-#define CALL                     (0x2000)
-#define SKIP_IF_EQ_IMM           (0x3000)
-#define SKIP_IF_NEQ_IMM          (0x4000)
-#define SKIP_IF_EQ               (0x5000)
-#define ASSIGN_VX_IMM            (0x6000)
-#define ADD_VX_IMM               (0x7000)
-#define ASSIGN_VX_VY             (0x8000)
-#define OR_VX_VY                 (0x8001)
-#define AND_VX_VY                (0x8002)
-#define XOR_VX_VY                (0x8003)
-#define ADD_VX_VY                (0x8004)
-#define SUB_VX_VY                (0x8005)
-#define RIGHT_SHIFT_VX_VY        (0x8006)
-#define VX_SUB_VY                (0x8007)
-#define LEFT_SHIFT_VX_VY         (0x800E)
-#define SET_I_ADDR               (0xA000)
-#define JUMP_PLUS_V0             (0xB000)
-#define RAND                     (0xC000)
-#define DRAW_SPRITE              (0xD000)
-#define SKIP_IF_KEY_PRESSED      (0xE09E)
-#define SKIP_IF_KEY_NOT_PRESSED  (0xE0A1)
-#define SET_VX_TIMER             (0xF007)
-#define KEY_AWAIT_STORE          (0xF00A)
-#define SET_DELAY_TIMER          (0xF015)
-#define SET_SOUND_TIMER          (0xF018)
-#define ADD_I_VX                 (0xF01E)
-#define SET_I_SPRITE_LOCATION    (0xF029)
-#define SET_BCD_VX               (0xF033)
-#define REG_DUMP                 (0xF055)
-#define REG_LOAD                 (0xF065)
-
-
-const uint8_t hex_sprites[] = {
-    0xF0, 0x90, 0x90, 0x90, 0xF0, // 0
-    0x20, 0x60, 0x20, 0x20, 0x70, // 1
-    0xF0, 0x10, 0xF0, 0x80, 0xF0, // 2
-    0xF0, 0x10, 0xF0, 0x10, 0xF0, // 3
-    0x90, 0x90, 0xF0, 0x10, 0x10, // 4
-    0xF0, 0x80, 0xF0, 0x10, 0xF0, // 5
-    0xF0, 0x80, 0xF0, 0x90, 0xF0, // 6
-    0xF0, 0x10, 0x20, 0x40, 0x40, // 7
-    0xF0, 0x90, 0xF0, 0x90, 0xF0, // 8
-    0xF0, 0x90, 0xF0, 0x10, 0xF0, // 9
-    0xF0, 0x90, 0xF0, 0x90, 0x90, // A
-    0xE0, 0x90, 0xE0, 0x90, 0xE0, // B
-    0xF0, 0x80, 0x80, 0x80, 0xF0, // C
-    0xE0, 0x90, 0x90, 0x90, 0xE0, // D
-    0xF0, 0x80, 0xF0, 0x80, 0xF0, // E
-    0xF0, 0x80, 0xF0, 0x80, 0x80, // F
-};
-
-typedef struct
-{
-    uint16_t stack_arr[CHIP8_STACK_SIZE];
-    uint8_t stack_pointer;
-} Stack;
-
-void stack_push(Stack* stack, uint16_t val)
-{
-    /* if (stack->stack_pointer + 1 > CHIP8_STACK_SIZE) */
-    /* { */
-    /*     DEBUG_PRINT("WARNING: STACK OVERFLOW\n"); */
-    /*     return; */
-    /* } */
-
-    stack->stack_arr[stack->stack_pointer] = val;
-    stack->stack_pointer++;
-}
-
-uint16_t stack_pop(Stack* stack)
-{
-    /* if (stack->stack_pointer == 0) */
-    /* { */
-    /*     DEBUG_PRINT("WARNING: popping from empty stack\n"); */
-    /*     return 0; */
-    /* } */
-
-    stack->stack_pointer--;
-    uint16_t val = stack->stack_arr[stack->stack_pointer];
-
-    return val;
-}
-
-bool is_instruction(uint16_t opcode, uint16_t instruction)
-{
-    return (opcode & instruction);
-}
-
-typedef union
-{
-    uint8_t V[16];
-    struct
-    {
-        uint8_t V0;
-        uint8_t V1;
-        uint8_t V2;
-        uint8_t V3;
-        uint8_t V4;
-        uint8_t V5;
-        uint8_t V6;
-        uint8_t V7;
-        uint8_t V8;
-        uint8_t V9;
-        uint8_t VA;
-        uint8_t VB;
-        uint8_t VC;
-        uint8_t VD;
-        uint8_t VE;
-        uint8_t VF;
-    };
-} Registers;
-
 uint8_t chip8_key_to_keyboard_key[] = {
     [0x0] = KEY_X,
     [0x1] = KEY_ONE,
@@ -179,110 +67,54 @@ uint8_t chip8_key_to_keyboard_key[] = {
     [0xf] = KEY_V,
 };
 
-uint8_t keyboard_key_to_chip8_key[] = {
-    [KEY_X] = 0x0,
-    [KEY_ONE] = 0x1,
-    [KEY_TWO] = 0x2,
-    [KEY_THREE] = 0x3,
-    [KEY_Q] = 0x4,
-    [KEY_W] = 0x5,
-    [KEY_E] = 0x6,
-    [KEY_A] = 0x7,
-    [KEY_S] = 0x8,
-    [KEY_D] = 0x9,
-    [KEY_Z] = 0xa,
-    [KEY_C] = 0xb,
-    [KEY_FOUR] = 0xc,
-    [KEY_R] = 0xd,
-    [KEY_F] = 0xe,
-    [KEY_V] = 0xf,
-};
+// Window pixels per low resolution pixel, the texture is always high resolution
+#define SCALE_FACTOR (16U)
+#define TEXTURE_SCALE (SCALE_FACTOR * WIDTH / CHIP8_HIRES_WIDTH)
 
-bool key_state[] = {
-    [KEY_ONE] = false,
-    [KEY_TWO] = false,
-    [KEY_THREE] = false,
-    [KEY_FOUR] = false,
-    [KEY_Q] = false,
-    [KEY_W] = false,
-    [KEY_E] = false,
-    [KEY_R] = false,
-    [KEY_A] = false,
-    [KEY_S] = false,
-    [KEY_D] = false,
-    [KEY_F] = false,
-    [KEY_Z] = false,
-    [KEY_X] = false,
-    [KEY_C] = false,
-    [KEY_V] = false,
-};
+Chip8 chip8;
 
-#define INSTRUCTION_SIZE (2)
+// Hotkeys are latched while pacing polls between frames, raylib only reports a
+// press to IsKeyPressed until the next poll
+static const int hotkeys[] = { KEY_F1, KEY_F5, KEY_F6, KEY_F7, KEY_F8, KEY_F9 };
+static uint32_t hotkeys_latched;
 
-uint8_t memory[CHIP8_MEMORY_SIZE];
-Registers registers;
-uint16_t I;
-Stack stack;
-static uint16_t program_counter = 0;
-static uint16_t delay_timer = 0;
-static uint16_t sound_timer = 0;
+void get_input()
+{
+    uint16_t keypad = 0;
+    for (int key = 0; key < CHIP8_KEY_COUNT; key++)
+    {
+        if (IsKeyDown(chip8_key_to_keyboard_key[key]))
+        {
+            DEBUG_PRINT("chip8 key 0x%x is pressed\n", key);
+            keypad |= 1U << key;
+        }
+    }
+    input_sample(keypad, host_time_ns());
 
-#define WIDTH (64U)
-#define HEIGHT (32U)
-#define SCALE_FACTOR (16U)
+    for (size_t i = 0; i < ARRAY_SIZE(hotkeys); i++)
+    {
+        if (IsKeyPressed(hotkeys[i]))
+            hotkeys_latched |= 1U << i;
+    }
+}
 
-bool display[WIDTH][HEIGHT];
+#ifndef PLATFORM_WEB
+// Runs from pacing's wait loop, so a key change gets its own timestamp instead of the next frame's
+static void poll_input(void)
+{
+    PollInputEvents();
+    get_input();
+}
+#endif
 
-void get_input()
+static bool hotkey_pressed(int key)
 {
-    key_state[KEY_ONE] = IsKeyDown(KEY_ONE);
-    if (key_state[KEY_ONE])
-        DEBUG_PRINT("keys.key_one_pressed is true\n");
-    key_state[KEY_TWO] = IsKeyDown(KEY_TWO);
-    if (key_state[KEY_TWO])
-        DEBUG_PRINT("keys.key_two_pressed is true\n");
-    key_state[KEY_THREE] = IsKeyDown(KEY_THREE);
-    if (key_state[KEY_THREE])
-        DEBUG_PRINT("keys.key_three_pressed is true\n");
-    key_state[KEY_FOUR] = IsKeyDown(KEY_FOUR);
-    if (key_state[KEY_FOUR])
-        DEBUG_PRINT("keys.key_four_pressed is true\n");
-    key_state[KEY_Q] = IsKeyDown(KEY_Q);
-    if (key_state[KEY_Q])
-        DEBUG_PRINT("keys.key_q_pressed is true\n");
-    key_state[KEY_W] = IsKeyDown(KEY_W);
-    if (key_state[KEY_W])
-        DEBUG_PRINT("keys.key_w_pressed is true\n");
-    key_state[KEY_E] = IsKeyDown(KEY_E);
-    if (key_state[KEY_E])
-        DEBUG_PRINT("keys.key_e_pressed is true\n");
-    key_state[KEY_R] = IsKeyDown(KEY_R);
-    if (key_state[KEY_R])
-        DEBUG_PRINT("keys.key_r_pressed is true\n");
-    key_state[KEY_A] = IsKeyDown(KEY_A);
-    if (key_state[KEY_A])
-        DEBUG_PRINT("keys.key_a_pressed is true\n");
-    key_state[KEY_S] = IsKeyDown(KEY_S);
-    if (key_state[KEY_S])
-        DEBUG_PRINT("keys.key_s_pressed is true\n");
-    key_state[KEY_D] = IsKeyDown(KEY_D);
-    if (key_state[KEY_D])
-        DEBUG_PRINT("keys.key_d_pressed is true\n");
-    key_state[KEY_F] = IsKeyDown(KEY_F);
-    if (key_state[KEY_F])
-        DEBUG_PRINT("keys.key_f_pressed is true\n");
-    key_state[KEY_Z] = IsKeyDown(KEY_Z);
-    if (key_state[KEY_Z])
-        DEBUG_PRINT("keys.key_z_pressed is true\n");
-    key_state[KEY_X] = IsKeyDown(KEY_X);
-    if (key_state[KEY_X])
-        DEBUG_PRINT("keys.key_x_pressed is true\n");
-    key_state[KEY_C] = IsKeyDown(KEY_C);
-    if (key_state[KEY_C])
-        DEBUG_PRINT("keys.key_c_pressed is true\n");
-    key_state[KEY_V] = IsKeyDown(KEY_V);
-    if (key_state[KEY_V])
-        DEBUG_PRINT("keys.key_v_pressed is true\n");
+    for (size_t i = 0; i < ARRAY_SIZE(hotkeys); i++)
+    {
+        if (hotkeys[i] == key)
+            return (hotkeys_latched >> i) & 1;
+    }
+    return false;
 }
 
 void dump_program(const char *program_name)
@@ -304,587 +136,631 @@ void dump_program(const char *program_name)
     fclose(program);
 }
 
-void dump_display_memory()
+// The sound timer's tone, generated on raylib's audio thread
+static Buzzer buzzer;
+static AudioStream buzzer_stream;
+static uint32_t audio_buffer_frames = BUZZER_DEFAULT_BUFFER_FRAMES;
+
+static void buzzer_callback(void *buffer, unsigned int frames)
+{
+    buzzer_render(&buzzer, buffer, frames);
+}
+
+// --wav renders a second buzzer against emulated time, one tick's worth of samples per
+// emulated frame, so the file is correctly timed whatever the host's pacing did
+static const char *wav_path = NULL;
+static WavWriter wav;
+static Buzzer wav_buzzer;
+static uint64_t wav_ticks;
+
+static void wav_record_tick(void)
+{
+    int16_t samples[BUZZER_MAX_TICK_SAMPLES(BUZZER_SAMPLE_RATE)];
+    size_t count = buzzer_tick_samples(&wav_buzzer, wav_ticks++);
+    buzzer_update(&wav_buzzer, &chip8);
+    buzzer_render(&wav_buzzer, samples, count);
+    wav_write(&wav, samples, count);
+}
+
+Texture2D display_texture;
+Color display_pixels[CHIP8_HIRES_WIDTH * CHIP8_HIRES_HEIGHT];
+Chip8Display presented_display;
+// Indexed by plane 0's bit plus twice plane 1's, only XO-CHIP gets past the first two
+static const Color plane_colors[1 << CHIP8_PLANE_COUNT] = { WHITE, BLACK, GRAY, DARKGRAY };
+bool presented_hires;
+uint64_t last_frame_ns = 0;
+
+bool rom_loaded = false;
+
+static uint32_t instructions_per_frame = 1;
+
+// F5 saves the machine here and F9 restores it
+static const char *state_path = "chip8.state";
+
+// Number of frames to emulate past the real machine before presenting, 0 disables run-ahead
+static uint32_t run_ahead_frames = 0;
+static Chip8 run_ahead_snapshot;
+
+// --record keeps every emulated frame's keypad here and writes it out on exit
+static const char *movie_path = NULL;
+static Movie movie;
+
+// --coverage records which addresses ran as code or were used as data
+static const char *coverage_path = NULL;
+static CoverageMap coverage;
+
+// Set when a breakpoint or watchpoint stops the machine, F6 continues and F7 steps.
+// With shift held both go backwards instead
+static bool debugger_paused = false;
+
+static Chip8Status step_with_coverage(Chip8 *machine)
 {
-    DEBUG_PRINT("Display Memory");
-	for (int i = 0; i < WIDTH; i++)
+    return chip8_step_coverage(machine, &coverage);
+}
+
+// A breakpoint or watchpoint ends the run early and pauses the machine, returns the
+// number of instructions that executed
+static uint32_t run_instructions(Chip8 *machine, uint32_t count)
+{
+    // The debug step only runs while something is set and records coverage itself,
+    // otherwise the plain one does
+    Chip8Status (*step)(Chip8 *) = chip8_step;
+    if (debugger_active())
+        step = chip8_step_debug;
+    else if (coverage_path != NULL)
+        step = step_with_coverage;
+
+    for (uint32_t i = 0; i < count; i++)
     {
-        for (int j = 0; j < HEIGHT; j++)
+        Chip8Status status = step(machine);
+        if (status == CHIP8_BREAKPOINT || status == CHIP8_WATCHPOINT)
+        {
+            debugger_print_stop(machine);
+            debugger_paused = true;
+            // The instruction behind a watchpoint did run, the one at a breakpoint did not
+            return status == CHIP8_WATCHPOINT ? i + 1 : i;
+        }
+        if (status != CHIP8_OK)
         {
-            DEBUG_PRINT("0x%02x  ", display[i][j]);
+            fprintf(stderr, "ERROR: %s 0x%04x at PC=0x%03x\n", chip8_status_name(status),
+                    chip8_fetch(machine), machine->program_counter);
+            exit(1);
         }
-        DEBUG_PRINT("\n");
     }
+    return count;
+}
+
+// One predicted EMULATION_HZ tick: timers count down, then the CPU runs its share of
+// instructions. The frame gets thrown away, so it runs on the plain interpreter and
+// records no coverage, and a trap only ends the prediction: false once it trapped
+static bool emulate_speculative_tick(Chip8 *machine)
+{
+    chip8_tick_timers(machine);
+    for (uint32_t i = 0; i < instructions_per_frame; i++)
+    {
+        if (chip8_step(machine) != CHIP8_OK)
+            return false;
+    }
+    return true;
+}
+
+// The real machine's tick in progress. The debugger can stop the machine partway
+// through one, the rest of its instructions run when it continues or steps, before
+// any new tick starts, so stopping doesn't change how many instructions a tick gets
+static bool live_tick_open = false;
+static uint64_t live_tick;
+static uint32_t live_tick_done;
+
+// Starts the real machine's tick: timers count down, then the CPU owes its share of
+// instructions to run_live_tick
+static void begin_live_tick(uint64_t tick)
+{
+    while (input_next_instruction(tick, instructions_per_frame) == 0)
+        input_apply(&chip8, 0);
+    if (movie_path != NULL)
+        movie_record_frame(&movie, chip8.keypad);
+    timetravel_frame(&chip8);
+    chip8_tick_timers(&chip8);
+
+    live_tick_open = true;
+    live_tick = tick;
+    live_tick_done = 0;
 }
 
-void execute_instruction(uint16_t opcode)
+// Ends the tick once all of its instructions ran
+static void count_live_instructions(uint32_t executed)
 {
-    DEBUG_PRINT("Opcode: 0x%04x\n", opcode);
-    DEBUG_PRINT("Before program executed, program counter: 0x%04x\n", program_counter);
+    timetravel_advance(executed);
+    perf_counters.instructions += executed;
+    live_tick_done += executed;
+    if (live_tick_done < instructions_per_frame)
+        return;
+
+    live_tick_open = false;
+    if (wav_path != NULL)
+        wav_record_tick();
+    rewind_push(&chip8);
+    perf_counters.emulated_frames++;
+}
 
-    if ((opcode & 0xF000) == 0x1000)
+// Runs what the open tick still owes, until the debugger stops it. Key changes go in
+// at the instruction the emulated clock had reached when they happened, except while
+// recording: a movie holds one keypad per frame, so then they wait for the next tick
+static void run_live_tick(void)
+{
+    while (live_tick_open && !debugger_paused)
     {
-        DEBUG_PRINT("Found JUMP_ADDR instruction\n");
-        uint16_t value = opcode & 0x0FFF;
-        DEBUG_PRINT("Setting program counter to %d\n", value);
-        program_counter = value;
+        uint32_t until = instructions_per_frame;
+        if (movie_path == NULL)
+        {
+            uint32_t next_input = input_next_instruction(live_tick, instructions_per_frame);
+            if (next_input <= live_tick_done)
+            {
+                input_apply(&chip8, live_tick_done);
+                timetravel_input(&chip8);
+                continue;
+            }
+            if (next_input < until)
+                until = next_input;
+        }
+
+        count_live_instructions(run_instructions(&chip8, until - live_tick_done));
     }
-    else if ((opcode & 0xF000) == 0x2000)
+}
+
+// Makes machine's display the one drawn this frame
+static void present(const Chip8 *machine)
+{
+    memcpy(presented_display, machine->display, sizeof(presented_display));
+    presented_hires = machine->hires;
+}
+
+// Runs the machine run_ahead_frames into the future with the newest input sample held,
+// presents that frame and rolls back, hiding the frame of latency between get_input
+// and the guest reacting to it. When the predicted future traps, what it reached before
+// the trap is presented
+static void run_ahead()
+{
+    uint64_t start_ns = host_time_ns();
+    chip8_snapshot(&chip8, &run_ahead_snapshot);
+
+    uint64_t snapshot_ns = host_time_ns();
+    chip8.keypad = input_latest_keypad();
+    for (uint32_t frame = 0; frame < run_ahead_frames; frame++)
     {
-        DEBUG_PRINT("Found CALL instruction\n");
-        uint16_t value = opcode & 0x0FFF;
-        DEBUG_PRINT("Calling function at address %d\n", value);
-        DEBUG_PRINT("Pushing address %d to the stack\n", program_counter);
-        stack_push(&stack, program_counter);
-        program_counter = value;
+        if (!emulate_speculative_tick(&chip8))
+            break;
     }
-    else if ((opcode & 0xF000) == 0x3000)
+    present(&chip8);
+
+    uint64_t run_ns = host_time_ns();
+    chip8_restore(&chip8, &run_ahead_snapshot);
+    uint64_t restore_ns = host_time_ns();
+
+    perf_counters.run_ahead_frames++;
+    perf_counters.snapshot_ns += snapshot_ns - start_ns;
+    perf_counters.run_ahead_ns += run_ns - snapshot_ns;
+    perf_counters.restore_ns += restore_ns - run_ns;
+}
+
+static void UpdateDrawFrame()
+{
+#ifdef PLATFORM_WEB
+    if (!rom_loaded)
     {
-        DEBUG_PRINT("Found SE Vx, byte instruction\n");
-        uint8_t vx = (opcode & 0x0F00) >> 8;
-        uint8_t val = (opcode & 0x00FF);
-        DEBUG_PRINT("Registers[%d] = %d\n", vx, registers.V[vx]);
-        DEBUG_PRINT("val = %d\n", val);
+        printf("Waiting for ROM file to get set\n");
+        emscripten_pause_main_loop();
+        return;
+    }
+#endif
 
-        if (registers.V[vx] == val)
-        {
-            DEBUG_PRINT("register[%d] == %d, skipping next instruction\n", vx, val);
-            program_counter += 2 * INSTRUCTION_SIZE;
-        }
-        else
+    trace_begin(TRACE_FRAME);
+
+    uint64_t frame_start_ns = host_time_ns();
+    if (last_frame_ns != 0)
+        overlay_record_frame_time(frame_start_ns - last_frame_ns);
+    last_frame_ns = frame_start_ns;
+    perf_counters.host_frames++;
+
+    // Get keyboard input
+    trace_begin(TRACE_GET_INPUT);
+    get_input();
+    if (hotkey_pressed(KEY_F1))
+        overlay_visible = !overlay_visible;
+    if (hotkey_pressed(KEY_F5) && savestate_save_file(&chip8, state_path))
+        printf("Saved state to %s\n", state_path);
+    if (hotkey_pressed(KEY_F9))
+    {
+        // A movie replays from power-on, there is no way to express a jump in it
+        if (movie_path != NULL)
+            printf("Loading states is disabled while recording a movie\n");
+        else if (savestate_load_file(&chip8, state_path))
         {
-            DEBUG_PRINT("register[%d] != %d, not skipping next instruction\n", vx, val);
-            program_counter += INSTRUCTION_SIZE;
+            printf("Loaded state from %s\n", state_path);
+            timetravel_reset(&chip8);
+            live_tick_open = false;
         }
     }
-    else if ((opcode & 0xF000) == 0x4000)
+    bool shift = IsKeyDown(KEY_LEFT_SHIFT) || IsKeyDown(KEY_RIGHT_SHIFT);
+    if (debugger_paused && shift && (hotkey_pressed(KEY_F6) || hotkey_pressed(KEY_F7)))
     {
-        DEBUG_PRINT("Found SNE Vx, byte instruction\n");
-        uint8_t vx = (opcode & 0x0F00) >> 8;
-        uint8_t val = (opcode & 0x00FF);
-        DEBUG_PRINT("Registers[%d] != %d\n", vx, val);
-
-        if (registers.V[vx] != val)
+        // Going back mid-frame can't be expressed in a movie either
+        if (movie_path != NULL)
         {
-            program_counter += 2 * INSTRUCTION_SIZE;
+            printf("Time travel is disabled while recording a movie\n");
+        }
+        else if (hotkey_pressed(KEY_F7) ? timetravel_step_back(&chip8) : timetravel_continue_back(&chip8))
+        {
+            // The tick the machine is back in owes the rest of its instructions again
+            live_tick_open = timetravel_frame_progress(&live_tick_done)
+                             && live_tick_done < instructions_per_frame;
+            printf("Back at instruction %llu\n", (unsigned long long)timetravel_position());
+            debugger_print_registers(&chip8);
+            chip8.display_dirty = true;
         }
         else
         {
-            program_counter += INSTRUCTION_SIZE;
+            printf("Reached the start of the time travel history\n");
         }
     }
-    else if ((opcode & 0xF000) == 0x5000)
+    if (hotkey_pressed(KEY_F6) && debugger_paused && !shift)
+    {
+        input_flush(&chip8);
+        debugger_resume(&chip8);
+        debugger_paused = false;
+    }
+    if (hotkey_pressed(KEY_F8) && !debugger_paused)
+    {
+        debugger_paused = true;
+        printf("Paused\n");
+        debugger_print_registers(&chip8);
+    }
+    // A movie holds whole frames, a frame interrupted for single steps would record the
+    // keypad at its start while the steps run with later keys
+    if (hotkey_pressed(KEY_F7) && debugger_paused && !shift && movie_path != NULL)
+    {
+        printf("Stepping is disabled while recording a movie\n");
+    }
+    else if (hotkey_pressed(KEY_F7) && debugger_paused && !shift)
     {
-        DEBUG_PRINT("Found SE Vx, Vy instruction\n");
-        uint8_t vx = (opcode & 0x0F00) >> 8;
-        uint8_t vy = (opcode & 0x00F0) >> 4;
-        DEBUG_PRINT("Registers[%d] == Registers[%d]\n", vx, vy);
+        debugger_resume(&chip8);
+        input_flush(&chip8);
+        // A step is the next instruction of the open tick, or the first of a new one
+        if (!live_tick_open)
+            begin_live_tick(pacing_ticks_done());
+        timetravel_input(&chip8);
+        Chip8Status status = chip8_step_debug(&chip8);
+        if (status == CHIP8_OK || status == CHIP8_WATCHPOINT)
+            count_live_instructions(1);
+        if (status != CHIP8_OK && status != CHIP8_WATCHPOINT)
+            printf("Step stopped: %s\n", chip8_status_name(status));
+        if (status == CHIP8_WATCHPOINT)
+            debugger_print_stop(&chip8);
+        else
+            debugger_print_registers(&chip8);
+    }
+    hotkeys_latched = 0;
+    trace_end(TRACE_GET_INPUT);
 
-        if (registers.V[vx] == registers.V[vy])
+    trace_begin(TRACE_EMULATION);
+    uint32_t ticks = pacing_emulation_ticks_due();
+    if (IsKeyDown(KEY_BACKSPACE))
+    {
+        // Holding backspace plays history backwards at the emulated frame rate
+        bool rewound = false;
+        for (uint32_t tick = 0; tick < ticks; tick++)
+        {
+            if (rewind_step_back(&chip8))
+            {
+                rewound = true;
+                if (movie_path != NULL)
+                    movie_drop_frame(&movie);
+            }
+        }
+        if (rewound)
         {
-            program_counter += 2 * INSTRUCTION_SIZE;
+            // Rewind states are taken between ticks. A tick the debugger stopped in
+            // already put its keypad in the movie, so that frame goes as well
+            if (live_tick_open && movie_path != NULL)
+                movie_drop_frame(&movie);
+            timetravel_reset(&chip8);
+            live_tick_open = false;
         }
-        else
+        input_flush(&chip8);
+        buzzer_silence(&buzzer);
+    }
+    else if (!debugger_paused)
+    {
+        uint64_t first_tick = pacing_ticks_done() - ticks;
+        run_live_tick();
+        for (uint32_t tick = 0; tick < ticks && !debugger_paused; tick++)
         {
-            program_counter += INSTRUCTION_SIZE;
+            begin_live_tick(first_tick + tick);
+            run_live_tick();
         }
+
+        trace_begin(TRACE_AUDIO);
+        if (ticks > 0)
+            buzzer_update(&buzzer, &chip8);
+        trace_end(TRACE_AUDIO);
     }
-    else if ((opcode & 0xF000) == 0x6000)
+    else
     {
-        DEBUG_PRINT("Found LD Vx, byte instruction\n");
-        uint8_t vx = (opcode & 0x0F00) >> 8;
-        uint8_t val = (opcode & 0x00FF);
-        DEBUG_PRINT("Registers[%d] = %d\n", vx, val);
-        registers.V[vx] = val;
-        program_counter += INSTRUCTION_SIZE;
+        // The sound timer doesn't run while the debugger holds the machine
+        buzzer_silence(&buzzer);
     }
-    else if ((opcode & 0xF000) == 0x7000)
+    perf_counters.audio_underruns = atomic_load(&buzzer.underruns);
+    trace_end(TRACE_EMULATION);
+
+    // A run-ahead frame can differ from the last one presented even when the real
+    // machine did not draw (the predicted input changed), so compare the pixels instead
+    bool redraw = chip8.display_dirty;
+    // Speculative frames would trip breakpoints the real machine has not reached yet
+    if (run_ahead_frames > 0 && !debugger_active())
     {
-        DEBUG_PRINT("Found ADD Vx, byte instruction\n");
-        uint8_t vx = (opcode & 0x0F00) >> 8;
-        uint8_t val = (opcode & 0x00FF);
-        /* DEBUG_PRINT("Registers[%d] += %d\n", vx, val); */
-        DEBUG_PRINT("Before Register[%d] = %d\n", vx, registers.V[vx]);
-        registers.V[vx] += val;
-        DEBUG_PRINT("After Register[%d] = %d\n", vx, registers.V[vx]);
-        program_counter += INSTRUCTION_SIZE;
+        trace_begin(TRACE_RUN_AHEAD);
+        Chip8Display previous_display;
+        memcpy(previous_display, presented_display, sizeof(previous_display));
+        bool previous_hires = presented_hires;
+        run_ahead();
+        redraw = memcmp(previous_display, presented_display, sizeof(previous_display)) != 0
+                 || previous_hires != presented_hires;
+        trace_end(TRACE_RUN_AHEAD);
     }
-    else if ((opcode & 0xF000) == 0x8000)
+    else if (redraw)
     {
-        uint16_t sub_code = opcode & 0x000F;
-        switch (sub_code)
-        {
-        case 0x0:
+        present(&chip8);
+    }
+    chip8.display_dirty = false;
+
+    trace_begin(TRACE_DRAW);
+    if (redraw)
+    {
+        // Low resolution pixels cover 2x2 texels
+        uint32_t shift = presented_hires ? 0 : 1;
+        for (uint32_t y = 0; y < CHIP8_HIRES_HEIGHT; y++)
         {
-            DEBUG_PRINT("Found LD Vx, Vy instruction\n");
-            uint8_t vx = (opcode & 0x0F00) >> 8;
-            uint8_t vy = (opcode & 0x00F0) >> 4;
-            DEBUG_PRINT("registers[%d] = registers[%d]\n", vx, vy);
-            registers.V[vx] = registers.V[vy];
-            program_counter += INSTRUCTION_SIZE;
-            break;
+            for (uint32_t x = 0; x < CHIP8_HIRES_WIDTH; x++)
+            {
+                uint32_t color = chip8_display_pixel(presented_display[0], x >> shift, y >> shift)
+                                 | chip8_display_pixel(presented_display[1], x >> shift, y >> shift) << 1;
+                display_pixels[y * CHIP8_HIRES_WIDTH + x] = plane_colors[color];
+            }
         }
-        case 0x1:
+        UpdateTexture(display_texture, display_pixels);
+    }
+    else
+    {
+        perf_counters.redraws_skipped++;
+    }
+
+    overlay_update();
+
+    BeginDrawing();
+    DrawTextureEx(display_texture, (Vector2){ 0, 0 }, 0.0f, TEXTURE_SCALE, WHITE);
+    overlay_draw();
+    trace_end(TRACE_DRAW);
+
+    trace_begin(TRACE_END_DRAWING);
+    EndDrawing();
+    trace_end(TRACE_END_DRAWING);
+
+    trace_end(TRACE_FRAME);
+}
+
+// Responsibility of caller to malloc and free data, it is copied into the machine
+EMSCRIPTEN_API
+void set_rom(uint8_t* data, int length)
+{
+    if (length < 0 || !chip8_load_program(&chip8, data, length))
+        return;
+    chip8.stack.stack_pointer = 0;
+    rom_loaded = true;
+
+#ifdef PLATFORM_WEB
+    emscripten_resume_main_loop();
+#endif
+}
+
+int main(int argc, char** argv)
+// int program_entry_point(int argc, char** argv)
+{
+    chip8_init(&chip8, CHIP8_DEFAULT_SEED);
+
+#ifndef PLATFORM_WEB
+    // TODO decide on default ROM
+    char* program_name = "roms/morse_demo.ch8";
+    const char *load_state_path = NULL;
+    size_t rewind_capacity = REWIND_DEFAULT_CAPACITY;
+    size_t timetravel_capacity = TIMETRAVEL_DEFAULT_CAPACITY;
+    uint32_t checkpoint_interval = TIMETRAVEL_DEFAULT_INTERVAL;
+    Chip8Platform platform = CHIP8_PLATFORM_CHIP8;
+    uint8_t quirks = 0;
+    // The ROM database only fills in what isn't given on the command line
+    bool platform_given = false;
+    bool quirks_given = false;
+    bool instructions_per_frame_given = false;
+    const char *romdb_path = ROMDB_DEFAULT_PATH;
+    bool romdb_given = false;
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--trace") == 0 && i + 1 < argc)
         {
-            DEBUG_PRINT("Found OR Vx, Vy instruction\n");
-            uint8_t vx = (opcode & 0x0F00) >> 8;
-            uint8_t vy = (opcode & 0x00F0) >> 4;
-            DEBUG_PRINT("registers[%d] |= registers[%d]\n", vx, vy);
-            registers.V[vx] |= registers.V[vy];
-            program_counter += INSTRUCTION_SIZE;
-            break;
+            // Chrome trace-event JSON of per-frame phase timings
+            if (!trace_open(argv[++i], TRACE_DEFAULT_CAPACITY))
+                return 1;
         }
-        case 0x2:
+        else if (strcmp(argv[i], "--platform") == 0 && i + 1 < argc)
         {
-            DEBUG_PRINT("Found AND Vx, Vy instruction\n");
-            uint8_t vx = (opcode & 0x0F00) >> 8;
-            uint8_t vy = (opcode & 0x00F0) >> 4;
-            DEBUG_PRINT("registers[%d] &= registers[%d]\n", vx, vy);
-            registers.V[vx] &= registers.V[vy];
-            program_counter += INSTRUCTION_SIZE;
-            break;
+            // chip8, schip or xochip, instructions of other platforms trap
+            if (!chip8_parse_platform(argv[++i], &platform))
+            {
+                fprintf(stderr, "Unknown platform %s\n", argv[i]);
+                return 1;
+            }
+            platform_given = true;
         }
-        case 0x3:
+        else if (strcmp(argv[i], "--quirks") == 0 && i + 1 < argc)
         {
-            DEBUG_PRINT("Found XOR Vx, Vy instruction\n");
-            uint8_t vx = (opcode & 0x0F00) >> 8;
-            uint8_t vy = (opcode & 0x00F0) >> 4;
-            DEBUG_PRINT("registers[%d] ^= registers[%d]\n", vx, vy);
-            registers.V[vx] ^= registers.V[vy];
-            program_counter += INSTRUCTION_SIZE;
-            break;
+            // none, vip, schip or xochip, see chip8_parse_quirks
+            if (!chip8_parse_quirks(argv[++i], &quirks))
+            {
+                fprintf(stderr, "Unknown quirk profile %s\n", argv[i]);
+                return 1;
+            }
+            quirks_given = true;
         }
-        case 0x4:
+        else if (strcmp(argv[i], "--romdb") == 0 && i + 1 < argc)
         {
-            DEBUG_PRINT("Found ADD Vx, Vy instruction\n");
-            uint8_t vx = (opcode & 0x0F00) >> 8;
-            uint8_t vy = (opcode & 0x00F0) >> 4;
-            DEBUG_PRINT("registers[%d] += registers[%d]\n", vx, vy);
-            uint8_t val = registers.V[vx] + registers.V[vy];
-            registers.VF = val > 255 ? 1 : 0;
-            registers.V[vx] = val;
-            program_counter += INSTRUCTION_SIZE;
-            break;
+            // Index built by romdb.py, the default one is only used when it exists
+            romdb_path = argv[++i];
+            romdb_given = true;
         }
-        case 0x5:
+        else if (strcmp(argv[i], "--ipf") == 0 && i + 1 < argc)
         {
-            DEBUG_PRINT("Found SUB Vx, Vy instruction\n");
-            uint8_t vx = (opcode & 0x0F00) >> 8;
-            uint8_t vy = (opcode & 0x00F0) >> 4;
-            DEBUG_PRINT("registers[%d] -= registers[%d]\n", vx, vy);
-            uint8_t val = registers.V[vx] - registers.V[vy];
-            registers.VF = registers.V[vx] > registers.V[vy] ? 1 : 0;
-            registers.V[vx] = val;
-            program_counter += INSTRUCTION_SIZE;
-            break;
+            instructions_per_frame = (uint32_t)strtoul(argv[++i], NULL, 0);
+            instructions_per_frame_given = true;
         }
-        case 0x6:
+        else if (strcmp(argv[i], "--run-ahead") == 0 && i + 1 < argc)
         {
-            DEBUG_PRINT("Found SHR Vx, { Vy } instruction\n");
-            uint8_t vx = (opcode & 0x0F00) >> 8;
-            DEBUG_PRINT("registers[%d] >> 1\n", vx);
-            uint8_t val = registers.V[vx] >> 1;
-            registers.VF = registers.V[vx] & 0x1 ? 1 : 0;
-            registers.V[vx] = val;
-            program_counter += INSTRUCTION_SIZE;
-            break;
+            run_ahead_frames = (uint32_t)strtoul(argv[++i], NULL, 0);
         }
-        case 0x7:
+        else if (strcmp(argv[i], "--state") == 0 && i + 1 < argc)
         {
-            DEBUG_PRINT("Found SUBN Vx, Vy instruction\n");
-            uint8_t vx = (opcode & 0x0F00) >> 8;
-            uint8_t vy = (opcode & 0x00F0) >> 4;
-            DEBUG_PRINT("registers[%d] -= registers[%d]\n", vy, vx);
-            uint8_t val = registers.V[vy] - registers.V[vx];
-            registers.VF = registers.V[vy] > registers.V[vx] ? 1 : 0;
-            registers.V[vx] = val;
-            program_counter += INSTRUCTION_SIZE;
-            break;
+            state_path = argv[++i];
         }
-        case 0xE:
+        else if (strcmp(argv[i], "--load-state") == 0 && i + 1 < argc)
         {
-            DEBUG_PRINT("Found SHL Vx, Vy instruction\n");
-            uint8_t vx = (opcode & 0x0F00) >> 8;
-            DEBUG_PRINT("registers[%d] << 1\n", vx);
-            uint8_t val = registers.V[vx] << 1;
-            registers.VF = registers.V[vx] & 0x80 ? 1 : 0;
-            registers.V[vx] = val;
-            program_counter += INSTRUCTION_SIZE;
-            break;
+            load_state_path = argv[++i];
         }
-        default:
-            DEBUG_PRINT("Invalid instruction: 0x%04x\n", opcode);
-            exit(1);
-            break;
-        }
-    }
-    else if ((opcode & 0xF00F) == 0x9000)
-    {
-        DEBUG_PRINT("Found SNE Vx, Vy instruction\n");
-        uint8_t vx = (opcode & 0x0F00) >> 8;
-        uint8_t vy = (opcode & 0x00F0) >> 4;
-        DEBUG_PRINT("Skipping if registers[%d] != registers[%d]\n", vx, vy);
-        if (registers.V[vx] != registers.V[vy])
+        else if (strcmp(argv[i], "--rewind-mb") == 0 && i + 1 < argc)
         {
-            program_counter += 2 * INSTRUCTION_SIZE;
+            // 0 turns the rewind history off
+            rewind_capacity = strtoul(argv[++i], NULL, 0) * 1024 * 1024;
         }
-        else
+        else if (strcmp(argv[i], "--timetravel-mb") == 0 && i + 1 < argc)
         {
-            program_counter += INSTRUCTION_SIZE;
+            // 0 turns reverse stepping off
+            timetravel_capacity = strtoul(argv[++i], NULL, 0) * 1024 * 1024;
         }
-    }
-    else if ((opcode & 0xF000) == 0xA000)
-    {
-        DEBUG_PRINT("Found LD I, addr instruction\n");
-        uint16_t val = opcode & 0x0FFF;
-        DEBUG_PRINT("I = 0x%x\n", val);
-        I = val;
-        program_counter += INSTRUCTION_SIZE;
-    }
-    else if ((opcode & 0xF000) == 0xB000)
-    {
-        DEBUG_PRINT("Found JP V0, addr instruction\n");
-        uint16_t val = opcode & 0x0FFF;
-        DEBUG_PRINT("program_counter = registers[0] + %d\n", val);
-        program_counter = registers.V0 + val;
-    }
-    else if ((opcode & 0xF000) == 0xC000)
-    {
-        DEBUG_PRINT("Found RND Vx, byte instruction\n");
-        uint8_t vx = (opcode & 0x0F00) >> 8;
-        uint8_t val = (opcode & 0x00FF);
-        DEBUG_PRINT("Registers[%d] = rand() & %d\n", vx, val);
-        registers.V[vx] = (rand() % 255) & val;
-        program_counter += INSTRUCTION_SIZE;
-    }
-    else if ((opcode & 0xF000) == 0xD000)
-    {
-        DEBUG_PRINT("Draw: Before doing draw, PC=0x%x\n", program_counter);
-
-		uint8_t target_v_reg_x = (opcode & 0x0F00) >> 8;
-		uint8_t target_v_reg_y = (opcode & 0x00F0) >> 4;
-		uint8_t sprite_height = opcode & 0x000F;
-		uint8_t x_location = registers.V[target_v_reg_x];
-		uint8_t y_location = registers.V[target_v_reg_y];
-
-        DEBUG_PRINT("Drawing at x=%d y=%d using memory starting at I=0x%x\n", x_location, y_location, I);
-
-		registers.VF = 0;
-        for (int32_t i = 0; i < sprite_height; i++)
+        else if (strcmp(argv[i], "--checkpoint-interval") == 0 && i + 1 < argc)
         {
-            uint8_t sprite = memory[I + i];
-            DEBUG_PRINT("Sprite is located at address %d\n", I + i);
-            DEBUG_PRINT("Sprite: 0x%x\n", sprite);
-
-            for (size_t j = 0; j < 8; j++)
-            {
-                DEBUG_PRINT("Drawing X %d Y %d\n", y_location + i, x_location + j);
-                bool bit = sprite & (1 << (7-j));
-                DEBUG_PRINT("Bit at %d is %d\n", j, bit);
-
-                uint8_t x = (x_location + j) % WIDTH;
-                uint8_t y = (y_location + i) % HEIGHT;
-
-                bool previous_display_value = display[x][y];
-
-                display[x][y] ^= bit;
-                
-                bool new_display_value = display[x][y];
-
-                if (previous_display_value == 1 && new_display_value == 0)
-                {
-                    registers.VF = 1;
-                }
-            }
+            // Instructions between time travel checkpoints, the most a step back re-executes
+            checkpoint_interval = (uint32_t)strtoul(argv[++i], NULL, 0);
         }
-
-        DEBUG_PRINT("Draw: Adding two to program counter\n");
-        DEBUG_PRINT("Before: 0x%x\n", program_counter);
-        program_counter += INSTRUCTION_SIZE;
-        DEBUG_PRINT("After: 0x%x\n", program_counter);
-    }
-    else if ((opcode & 0xF0FF) == 0xE09E)
-    {
-        DEBUG_PRINT("Found SKP Vx instruction\n");
-        uint8_t vx = (opcode & 0x0F00) >> 0x8;
-        DEBUG_PRINT("Skipping next instruction if key registers[%d] is pressed\n", vx);
-        if (key_state[chip8_key_to_keyboard_key[registers.V[vx]]])
+        else if (strcmp(argv[i], "--audio-buffer") == 0 && i + 1 < argc)
         {
-            program_counter += 2 * INSTRUCTION_SIZE;
+            // Frames per audio callback, smaller means lower latency and more risk of crackling
+            audio_buffer_frames = (uint32_t)strtoul(argv[++i], NULL, 0);
         }
-        else
+        else if (strcmp(argv[i], "--wav") == 0 && i + 1 < argc)
         {
-            program_counter += INSTRUCTION_SIZE;
+            wav_path = argv[++i];
         }
-    }
-    else if ((opcode & 0xF0FF) == 0xE0A1)
-    {
-        DEBUG_PRINT("Found SKNP Vx instruction\n");
-        uint8_t vx = (opcode & 0x0F00) >> 0x8;
-        DEBUG_PRINT("Skipping next instruction if key registers[%d] is pressed\n", vx);
-        if (!key_state[chip8_key_to_keyboard_key[registers.V[vx]]])
+        else if (strcmp(argv[i], "--record") == 0 && i + 1 < argc)
         {
-            program_counter += 2 * INSTRUCTION_SIZE;
+            // Input movie, replay it with chip8-headless replay
+            movie_path = argv[++i];
         }
-        else
+        else if (strcmp(argv[i], "--coverage") == 0 && i + 1 < argc)
         {
-            program_counter += INSTRUCTION_SIZE;
+            // Code/data map written on exit, the debugger's stepper records into it too
+            coverage_path = argv[++i];
+            debugger_set_coverage(&coverage);
         }
-    }
-    else if ((opcode & 0xF000) == 0xF000)
-    {
-        DEBUG_PRINT("Found instruction that starts with F\n");
-        uint16_t sub_word = opcode & 0x00FF;
-        DEBUG_PRINT("Subword is 0x%x\n", sub_word);
-        switch (sub_word)
+        else if (strcmp(argv[i], "--break") == 0 && i + 1 < argc)
         {
-            case 0x07:
-            {
-                DEBUG_PRINT("Found LD Vx, DT instruction\n");
-                uint8_t vx = (opcode & 0x0F00) >> 0x8;
-                DEBUG_PRINT("Setting register[%d] == DT value\n", vx);
-                registers.V[vx] = delay_timer;
-                program_counter += INSTRUCTION_SIZE;
-                break;
-            }
-            case 0x0A:
-            {
-                DEBUG_PRINT("Found LD Vx, K instruction\n");
-                uint8_t vx = (opcode & 0x0F00) >> 0x8;
-                DEBUG_PRINT("Waiting for keypress to store in registers[%d]\n", vx);
-
-                // TODO need to make sure the key that is pressed is a chip8 key
-                int key = 0;
-                bool key_pressed = false;
-                DEBUG_PRINT("Size of the key_state array is %d\n", ARRAY_SIZE(key_state));
-                for (size_t i = 0; i < ARRAY_SIZE(key_state); i++)
-                {
-                    if (key_state[i])
-                    {
-                        DEBUG_PRINT("Key %d is pressed", i);
-                        key = i;
-                        key_pressed = true;
-                        break;
-                    }
-                }
-
-                if (key_pressed)
-                {
-                    registers.V[vx] = keyboard_key_to_chip8_key[key];
-                    program_counter += INSTRUCTION_SIZE;
-                }
-                break;
-            }
-            case 0x15:
-            {
-                DEBUG_PRINT("Found LD DT, Vx instruction\n");
-                uint8_t vx = (opcode & 0x0F00) >> 0x8;
-                DEBUG_PRINT("Setting DT == register[%d]\n", vx);
-                delay_timer = registers.V[vx];
-                program_counter += INSTRUCTION_SIZE;
-                break;
-            }
-            case 0x18:
-            {
-                DEBUG_PRINT("Found LD ST, Vx instruction\n");
-                uint8_t vx = (opcode & 0x0F00) >> 0x8;
-                DEBUG_PRINT("Setting ST == register[%d]\n", vx);
-                sound_timer = registers.V[vx];
-                program_counter += INSTRUCTION_SIZE;
-                break;
-            }
-            case 0x1E:
-            {
-                DEBUG_PRINT("Found ADD I, Vx instruction\n");
-                uint8_t vx = (opcode & 0x0F00) >> 0x8;
-                DEBUG_PRINT("Setting I += register[%d]\n", vx);
-                I += registers.V[vx];
-                program_counter += INSTRUCTION_SIZE;
-                break;
-            }
-            case 0x29:
-            {
-                DEBUG_PRINT("Found LD F, Vx instruction\n");
-                uint8_t vx = (opcode & 0x0F00) >> 0x8;
-                DEBUG_PRINT("Setting I hex sprite at register[%d]\n", vx);
-                I = 5 * registers.V[vx];
-                program_counter += INSTRUCTION_SIZE;
-                break;
-            }
-            case 0x33:
-            {
-                DEBUG_PRINT("Found LD F, Vx instruction\n");
-                uint8_t vx = (opcode & 0x0F00) >> 0x8;
-                uint16_t val = registers.V[vx];
-                uint16_t hundreds = val / 100;
-                uint16_t tens = (val - (100 * hundreds)) / 10;
-                uint16_t ones = (val - (100 * hundreds) - (10 * tens));
-                DEBUG_PRINT("Putting %d at I, %d at I+1, %d at I+2\n", hundreds, tens, ones);
-
-                memory[I] = hundreds;
-                memory[I+1] = tens;
-                memory[I+2] = ones;
-                program_counter += INSTRUCTION_SIZE;
-                break;
-            }
-            case 0x55:
-            {
-                // Store v0 through vx into memory locations starting from I
-
-                DEBUG_PRINT("Found LD [I], Vx instruction\n");
-                uint8_t vx = (opcode & 0x0F00) >> 0x8;
-
-                for (uint8_t i = 0; i <= vx; i++)
-                {
-                    DEBUG_PRINT("Storing %x into memory at %x", registers.V[i], I + i);
-                    memory[I + i] = registers.V[i];
-                }
-
-                program_counter += INSTRUCTION_SIZE;
-                break;
-            }
-            case 0x65:
-            {
-                // Load v0 through vx from memory locations starting at I
-
-                DEBUG_PRINT("Found LD Vx, [I] instruction\n");
-                uint8_t vx = (opcode & 0x0F00) >> 0x8;
-
-                for (uint8_t i = 0; i <= vx; i++)
-                {
-                    DEBUG_PRINT("Copying %x into V[%x]", memory[I + i], i);
-                    registers.V[i] = memory[I + i];
-                }
-
-                program_counter += INSTRUCTION_SIZE;
-                break;
-            }
+            if (!debugger_parse_breakpoint(argv[++i]))
+                return 1;
         }
-    }
-    else if ((opcode & 0x00F0) == 0x00E0)
-    {
-        switch(opcode)
+        else if (strcmp(argv[i], "--watch") == 0 && i + 1 < argc)
         {
-        case 0x00E0:
-        {
-            DEBUG_PRINT("Found CLEAR_SCREEN instruction\n");
-            memset(display, 0, 32 * 64);
-            program_counter += INSTRUCTION_SIZE;
-            break;
+            // first[-last][:r|:w|:rw], reads are DXYN/FX65/F002 and writes FX33/FX55
+            if (!debugger_parse_watchpoint(argv[++i]))
+                return 1;
         }
-        case 0x00EE:
+        else
         {
-            DEBUG_PRINT("Found RETURN_SUBROUTINE instruction\n");
-            program_counter = stack_pop(&stack);
-            DEBUG_PRINT("Setting program_counter back to %d and incrementing\n", program_counter);
-            program_counter += INSTRUCTION_SIZE;
-            break;
-        }
-        default:
-            DEBUG_PRINT("Invalid instruction: 0x%04x\n", opcode);
-            exit(1);
-            break;
+            program_name = argv[i];
         }
     }
-    else
-    {
-        DEBUG_PRINT("Invalid instruction 0x%x\n", opcode);
-        exit(1);
-    }
-    DEBUG_PRINT("After instruction executed, program counter: 0x%04x\n", program_counter);
-}
 
-uint16_t create_draw_instruction(uint8_t vx, uint8_t vy, uint8_t n)
-{
-	uint16_t opcode = 0xD000;
-	uint16_t X = (vx << 8) & 0x0F00;
-	uint16_t Y = (vy << 4) & 0x00F0;
-	uint16_t N = n & 0x000F;
-	return opcode | X | Y | N;
-}
-
-Sound beep_timer_sound;
-bool sound_playing = false;
-
-uint16_t* program_opcodes;
-
-static void UpdateDrawFrame()
-{
-#ifdef PLATFORM_WEB
-    if (program_opcodes == NULL)
+    // "-" is stdin, an inherited descriptor can be passed as /dev/fd/N
+    int program = strcmp(program_name, "-") == 0 ? STDIN_FILENO : open(program_name, O_RDONLY);
+    if (program < 0)
     {
-        printf("Waiting for ROM file to get set\n");
-        emscripten_pause_main_loop();
-        return;
+        fprintf(stderr, "Could not open program %s\n", program_name);
+        return 1;
     }
-#endif
-
-    // Get keyboard input
-    get_input();
-
-    uint16_t instruction = *(uint16_t*)(memory + program_counter);
-    uint8_t inst_low = (uint8_t)(instruction & 0xff);
-    uint8_t inst_high = (uint8_t)((instruction & 0xff00) >> 8);
 
-    instruction = ((uint16_t)inst_low << 8) | (uint16_t)inst_high;
-    execute_instruction(instruction);
-    DEBUG_PRINT("\n");
+    // Straight into guest memory, the ROM database and the movie read it from there
+    size_t program_size;
+    bool program_read = chip8_read_program(&chip8, program, &program_size);
+    if (program != STDIN_FILENO)
+        close(program);
+    if (!program_read)
+        return 1;
+    // Reading a program too big for classic memory already moved it to the XO-CHIP block
+    const uint8_t *program_data = CHIP8_MEMORY(&chip8) + CHIP8_PROGRAM_START;
+    DEBUG_PRINT("The program is %zu bytes long\n", program_size);
 
-    BeginDrawing();
-    for (int i = 0; i < WIDTH; i++)
+    if (romdb_given || access(romdb_path, R_OK) == 0)
     {
-        for (int j = 0; j < HEIGHT; j++)
+        RomDb romdb;
+        if (!romdb_load_file(&romdb, romdb_path))
+            return 1;
+
+        RomInfo info;
+        if (romdb_lookup(&romdb, program_data, program_size, &info))
         {
-            Color color = display[i][j] ? BLACK : WHITE;
-            DrawRectangle(SCALE_FACTOR * i, SCALE_FACTOR * j, SCALE_FACTOR * 8 , SCALE_FACTOR * 1, color);
+            if (!platform_given)
+                platform = info.platform;
+            if (!quirks_given)
+                quirks = info.quirks;
+            if (!instructions_per_frame_given)
+                instructions_per_frame = info.instructions_per_frame;
+            printf("%s is in %s: %s, quirks 0x%02x, %u instructions per frame\n", program_name, romdb_path,
+                   chip8_platform_name(info.platform), info.quirks, info.instructions_per_frame);
         }
+        romdb_free(&romdb);
     }
-    EndDrawing();
 
-    if (delay_timer > 0)
-        delay_timer--;
+    chip8_set_platform(&chip8, platform);
+    chip8_set_quirks(&chip8, quirks);
+    if (!chip8_program_fits(&chip8, program_size))
+        return 1;
+    program_data = CHIP8_MEMORY(&chip8) + CHIP8_PROGRAM_START;
+    rom_loaded = true;
 
-    if (sound_timer > 0)
-    {
-        if (!sound_playing)
-        {
-            PlaySound(beep_timer_sound);
-            sound_playing = true;
-        }
-        sound_timer--;
-    }
-    else
+    if (load_state_path != NULL && movie_path != NULL)
     {
-        StopSound(beep_timer_sound);
-        sound_playing = false;
+        fprintf(stderr, "--record starts from power-on and can't be combined with --load-state\n");
+        return 1;
     }
-}
 
-// Responsibility of caller to malloc and free data
-EMSCRIPTEN_API
-void set_rom(uint8_t* data, int length)
-{
-    printf("Setting ROM to %p with length %d\n", data, length);
-    program_opcodes = (uint16_t*)data;
+    if (load_state_path != NULL && !savestate_load_file(&chip8, load_state_path))
+        return 1;
+
+    if (movie_path != NULL)
+        movie_init(&movie, program_data, program_size, chip8.platform, chip8.quirks, chip8.rng_state,
+                   instructions_per_frame);
 
-    printf("Dumping out bytes:\n");
-    for (size_t i = 0; i < length; i++)
+    if (rewind_capacity > 0 && !rewind_init(rewind_capacity, &chip8))
+        return 1;
+
+    if (timetravel_capacity > 0 && !timetravel_init(timetravel_capacity, checkpoint_interval, &chip8))
+        return 1;
+
+    if (wav_path != NULL)
     {
-        printf("0x%x\n", data[i]);
+        if (!wav_open(&wav, wav_path, BUZZER_SAMPLE_RATE))
+            return 1;
+        buzzer_init(&wav_buzzer, BUZZER_SAMPLE_RATE);
     }
+    timetravel_reset(&chip8);
 
-    memcpy(&memory[0x200], program_opcodes, sizeof(uint16_t) * length);
-    program_counter = 0x200;
-    stack.stack_pointer = 0;
-
-#ifdef PLATFORM_WEB
-    emscripten_resume_main_loop();
 #endif
-}
 
-int main(int argc, char** argv)
-// int program_entry_point(int argc, char** argv)
-{
     InitAudioDevice();
     if (!IsAudioDeviceReady())
     {
@@ -892,36 +768,11 @@ int main(int argc, char** argv)
         exit(1);
     }
 
-    beep_timer_sound = LoadSound("beep-02.wav");
-
-#ifndef PLATFORM_WEB
-    // TODO decide on default ROM
-    char* program_name = "roms/morse_demo.ch8";
-    if (argc > 1)
-    {
-        program_name = argv[1];
-    }
-
-    memcpy(memory, hex_sprites, sizeof(hex_sprites));
-
-    FILE* program = fopen(program_name, "r");
-    if (program == NULL)
-    {
-        fprintf(stderr, "Could not open program %s\n", program_name);
-        return 1;
-    }
-
-    fseek(program, 0L, SEEK_END);
-    size_t program_size = ftell(program);
-    DEBUG_PRINT("The program is %lu bytes long\n", program_size);
-    rewind(program);
-
-    uint16_t program_data[MAX_PROGRAM_SIZE];
-    fread(program_data, sizeof(program_data[0]), program_size, program);
-
-    set_rom((uint8_t*)program_data, program_size);
-
-#endif
+    buzzer_init(&buzzer, BUZZER_SAMPLE_RATE);
+    SetAudioStreamBufferSizeDefault(audio_buffer_frames);
+    buzzer_stream = LoadAudioStream(BUZZER_SAMPLE_RATE, 16, 1);
+    SetAudioStreamCallback(buzzer_stream, buzzer_callback);
+    PlayAudioStream(buzzer_stream);
 
     struct timespec start_time, current_time;
     timespec_get(&start_time, TIME_UTC);
@@ -929,16 +780,48 @@ int main(int argc, char** argv)
 
     InitWindow(WIDTH * SCALE_FACTOR, HEIGHT * SCALE_FACTOR, "chip8");
 
+    Image display_image = GenImageColor(CHIP8_HIRES_WIDTH, CHIP8_HIRES_HEIGHT, WHITE);
+    display_texture = LoadTextureFromImage(display_image);
+    UnloadImage(display_image);
+    overlay_init();
+
 #if defined(PLATFORM_WEB)
+    // The browser paces frames with requestAnimationFrame, only the emulated clock is ours
+    pacing_init(EMULATION_HZ);
     emscripten_set_main_loop(UpdateDrawFrame, 0, 1);
 #else
-    SetTargetFPS(60);
+    pacing_init(GetMonitorRefreshRate(GetCurrentMonitor()));
+    pacing_set_poll(poll_input);
     while (!WindowShouldClose())
     {
         UpdateDrawFrame();
+        pacing_wait_for_next_frame();
     }
+    pacing_print_stats();
+    input_print_stats();
+
+    if (movie_path != NULL)
+    {
+        movie.final_hash = chip8_hash_full(&chip8);
+        if (movie_save_file(&movie, movie_path))
+            printf("Recorded %u frames to %s\n", movie.frame_count, movie_path);
+        movie_free(&movie);
+    }
+
+    if (wav_path != NULL && wav_close(&wav))
+        printf("Wrote %.1f s of audio to %s\n", (double)wav_ticks / EMULATION_HZ, wav_path);
+
+    if (coverage_path != NULL && coverage_save_file(&coverage, program_name, program_size, coverage_path))
+        printf("Wrote code/data map to %s\n", coverage_path);
 #endif
 
+    trace_close();
+    rewind_free();
+    timetravel_free();
+    overlay_unload();
+    UnloadAudioStream(buzzer_stream);
+    CloseAudioDevice();
+    UnloadTexture(display_texture);
     CloseWindow();
     
     return 0;
@@ -0,0 +1,294 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "host_time.h"
+#include "movie.h"
+#include "statehash.h"
+
+#define MOVIE_HEADER_SIZE (8 + 8 + 4 + 4 + 4 + 8 + 4)
+#define MOVIE_RUN_SIZE (2 + 4)
+
+static uint8_t *put_u16(uint8_t *out, uint16_t value)
+{
+    out[0] = value & 0xFF;
+    out[1] = value >> 8;
+    return out + 2;
+}
+
+static uint8_t *put_u32(uint8_t *out, uint32_t value)
+{
+    out = put_u16(out, value & 0xFFFF);
+    return put_u16(out, value >> 16);
+}
+
+static uint8_t *put_u64(uint8_t *out, uint64_t value)
+{
+    out = put_u32(out, value & 0xFFFFFFFF);
+    return put_u32(out, value >> 32);
+}
+
+static const uint8_t *get_u16(const uint8_t *in, uint16_t *value)
+{
+    *value = (uint16_t)in[0] | ((uint16_t)in[1] << 8);
+    return in + 2;
+}
+
+static const uint8_t *get_u32(const uint8_t *in, uint32_t *value)
+{
+    uint16_t low, high;
+    in = get_u16(in, &low);
+    in = get_u16(in, &high);
+    *value = (uint32_t)low | ((uint32_t)high << 16);
+    return in;
+}
+
+static const uint8_t *get_u64(const uint8_t *in, uint64_t *value)
+{
+    uint32_t low, high;
+    in = get_u32(in, &low);
+    in = get_u32(in, &high);
+    *value = (uint64_t)low | ((uint64_t)high << 32);
+    return in;
+}
+
+uint64_t movie_rom_hash(const uint8_t *rom, size_t size)
+{
+    uint64_t hash = 0xCBF29CE484222325ULL;
+    for (size_t i = 0; i < size; i++)
+    {
+        hash ^= rom[i];
+        hash *= 0x100000001B3ULL;
+    }
+    return hash;
+}
+
+void movie_init(Movie *movie, const uint8_t *rom, size_t rom_size, Chip8Platform platform,
+                uint8_t quirks, uint32_t seed, uint32_t instructions_per_frame)
+{
+    memset(movie, 0, sizeof(*movie));
+    movie->rom_hash = movie_rom_hash(rom, rom_size);
+    movie->platform = platform;
+    movie->quirks = quirks;
+    movie->seed = seed;
+    movie->instructions_per_frame = instructions_per_frame;
+}
+
+void movie_free(Movie *movie)
+{
+    free(movie->runs);
+    movie->runs = NULL;
+    movie->run_count = 0;
+    movie->run_capacity = 0;
+    movie->frame_count = 0;
+}
+
+static void movie_reserve_runs(Movie *movie, size_t count)
+{
+    if (count <= movie->run_capacity)
+        return;
+
+    size_t capacity = movie->run_capacity ? movie->run_capacity * 2 : 256;
+    while (capacity < count)
+        capacity *= 2;
+
+    MovieRun *runs = realloc(movie->runs, capacity * sizeof(MovieRun));
+    if (runs == NULL)
+    {
+        fprintf(stderr, "ERROR: out of memory while recording movie\n");
+        exit(1);
+    }
+    movie->runs = runs;
+    movie->run_capacity = capacity;
+}
+
+void movie_record_frame(Movie *movie, uint16_t keypad)
+{
+    if (movie->run_count > 0 && movie->runs[movie->run_count - 1].keypad == keypad)
+    {
+        movie->runs[movie->run_count - 1].frames++;
+    }
+    else
+    {
+        movie_reserve_runs(movie, movie->run_count + 1);
+        movie->runs[movie->run_count++] = (MovieRun){ .keypad = keypad, .frames = 1 };
+    }
+    movie->frame_count++;
+}
+
+void movie_drop_frame(Movie *movie)
+{
+    if (movie->run_count == 0)
+        return;
+
+    if (--movie->runs[movie->run_count - 1].frames == 0)
+        movie->run_count--;
+    movie->frame_count--;
+}
+
+bool movie_save_file(const Movie *movie, const char *path)
+{
+    size_t size = MOVIE_HEADER_SIZE + movie->run_count * MOVIE_RUN_SIZE;
+    uint8_t *buffer = malloc(size);
+    if (buffer == NULL)
+    {
+        fprintf(stderr, "Could not allocate %zu bytes for movie %s\n", size, path);
+        return false;
+    }
+
+    uint8_t *out = buffer;
+    memcpy(out, MOVIE_MAGIC, 4);
+    out = put_u16(out + 4, MOVIE_VERSION);
+    *out++ = movie->platform;
+    *out++ = movie->quirks;
+    out = put_u64(out, movie->rom_hash);
+    out = put_u32(out, movie->seed);
+    out = put_u32(out, movie->instructions_per_frame);
+    out = put_u32(out, movie->frame_count);
+    out = put_u64(out, movie->final_hash);
+    out = put_u32(out, movie->run_count);
+    for (size_t i = 0; i < movie->run_count; i++)
+    {
+        out = put_u16(out, movie->runs[i].keypad);
+        out = put_u32(out, movie->runs[i].frames);
+    }
+
+    bool ok = false;
+    FILE *file = fopen(path, "wb");
+    if (file == NULL)
+    {
+        fprintf(stderr, "Could not open movie %s for writing\n", path);
+    }
+    else
+    {
+        ok = fwrite(buffer, 1, size, file) == size;
+        ok = (fclose(file) == 0) && ok;
+        if (!ok)
+            fprintf(stderr, "Could not write movie %s\n", path);
+    }
+
+    free(buffer);
+    return ok;
+}
+
+bool movie_load_file(Movie *movie, const char *path)
+{
+    FILE *file = fopen(path, "rb");
+    if (file == NULL)
+    {
+        fprintf(stderr, "Could not open movie %s\n", path);
+        return false;
+    }
+
+    uint8_t header[MOVIE_HEADER_SIZE];
+    uint16_t version = 0;
+    if (fread(header, 1, sizeof(header), file) != sizeof(header)
+        || memcmp(header, MOVIE_MAGIC, 4) != 0)
+    {
+        fprintf(stderr, "%s is not a chip8 movie\n", path);
+        fclose(file);
+        return false;
+    }
+
+    const uint8_t *in = get_u16(header + 4, &version);
+    uint8_t platform = *in++;
+    uint8_t quirks = *in++;
+    if (version != MOVIE_VERSION)
+    {
+        fprintf(stderr, "Unsupported movie version %u\n", version);
+        fclose(file);
+        return false;
+    }
+    if (platform >= CHIP8_PLATFORM_COUNT || quirks >= CHIP8_QUIRK_COMBINATIONS)
+    {
+        fprintf(stderr, "Movie %s is corrupt\n", path);
+        fclose(file);
+        return false;
+    }
+
+    uint32_t run_count;
+    memset(movie, 0, sizeof(*movie));
+    movie->platform = platform;
+    movie->quirks = quirks;
+    in = get_u64(in, &movie->rom_hash);
+    in = get_u32(in, &movie->seed);
+    in = get_u32(in, &movie->instructions_per_frame);
+    in = get_u32(in, &movie->frame_count);
+    in = get_u64(in, &movie->final_hash);
+    in = get_u32(in, &run_count);
+
+    // Every run covers at least one frame
+    if (run_count > movie->frame_count)
+    {
+        fprintf(stderr, "Movie %s is corrupt\n", path);
+        fclose(file);
+        return false;
+    }
+
+    movie_reserve_runs(movie, run_count);
+    uint64_t frames = 0;
+    bool ok = true;
+    for (size_t i = 0; ok && i < run_count; i++)
+    {
+        uint8_t run[MOVIE_RUN_SIZE];
+        ok = fread(run, 1, sizeof(run), file) == sizeof(run);
+        get_u32(get_u16(run, &movie->runs[i].keypad), &movie->runs[i].frames);
+        frames += movie->runs[i].frames;
+    }
+    movie->run_count = run_count;
+    fclose(file);
+
+    if (!ok || frames != movie->frame_count)
+    {
+        fprintf(stderr, "Movie %s is corrupt\n", path);
+        movie_free(movie);
+        return false;
+    }
+    return true;
+}
+
+bool movie_replay(const Movie *movie, const uint8_t *rom, size_t rom_size,
+                  Chip8 *chip8, MovieReplayResult *result)
+{
+    memset(result, 0, sizeof(*result));
+    if (movie_rom_hash(rom, rom_size) != movie->rom_hash)
+    {
+        fprintf(stderr, "Movie was recorded against a different ROM\n");
+        return false;
+    }
+
+    chip8_init(chip8, movie->seed);
+    chip8_set_platform(chip8, movie->platform);
+    chip8_set_quirks(chip8, movie->quirks);
+    if (!chip8_load_program(chip8, rom, rom_size))
+        return false;
+    chip8_hash_rebuild(chip8);
+
+    // Same frame as the frontend's emulate_tick: timers first, then the CPU
+    Chip8Status status = CHIP8_OK;
+    uint64_t start_ns = host_time_ns();
+    for (size_t i = 0; i < movie->run_count && status == CHIP8_OK; i++)
+    {
+        chip8->keypad = movie->runs[i].keypad;
+        for (uint32_t frame = 0; frame < movie->runs[i].frames && status == CHIP8_OK; frame++)
+        {
+            chip8_tick_timers(chip8);
+            for (uint32_t step = 0; step < movie->instructions_per_frame && status == CHIP8_OK; step++)
+            {
+                status = chip8_step_hashed(chip8);
+                result->instructions++;
+            }
+            result->frames++;
+        }
+    }
+
+    result->elapsed_ns = host_time_ns() - start_ns;
+    result->final_hash = chip8_hash(chip8);
+    if (status != CHIP8_OK)
+    {
+        fprintf(stderr, "Replay stopped in frame %u: %s at PC=0x%03x\n", result->frames - 1,
+                chip8_status_name(status), chip8->program_counter);
+        return false;
+    }
+    return result->final_hash == movie->final_hash;
+}
@@ -0,0 +1,70 @@
+#ifndef MOVIE_H
+#define MOVIE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "chip8.h"
+
+// Input movie: everything needed to replay a session from power-on. Binary
+// layout, all multi-byte fields little endian:
+//   "C8MV" magic, u16 version, u8 platform, u8 quirks,
+//   u64 rom_hash, u32 seed, u32 instructions_per_frame,
+//   u32 frame_count, u64 final_hash, u32 run_count,
+//   run_count * (u16 keypad, u32 frames)
+// The keypad barely changes from one frame to the next, so it is stored run-length encoded
+#define MOVIE_MAGIC "C8MV"
+#define MOVIE_VERSION (1U)
+
+typedef struct
+{
+    uint16_t keypad;
+    uint32_t frames;
+} MovieRun;
+
+typedef struct
+{
+    uint64_t rom_hash;
+    Chip8Platform platform;
+    uint8_t quirks;
+    uint32_t seed;
+    uint32_t instructions_per_frame;
+    uint32_t frame_count;
+    // chip8_hash of the machine after the last frame
+    uint64_t final_hash;
+    MovieRun *runs;
+    size_t run_count;
+    size_t run_capacity;
+} Movie;
+
+typedef struct
+{
+    uint32_t frames;
+    uint64_t instructions;
+    uint64_t elapsed_ns;
+    uint64_t final_hash;
+} MovieReplayResult;
+
+// FNV-1a, identifies the ROM a movie was recorded against
+uint64_t movie_rom_hash(const uint8_t *rom, size_t size);
+
+void movie_init(Movie *movie, const uint8_t *rom, size_t rom_size, Chip8Platform platform,
+                uint8_t quirks, uint32_t seed, uint32_t instructions_per_frame);
+void movie_free(Movie *movie);
+
+// Appends the keypad held during the next emulated frame
+void movie_record_frame(Movie *movie, uint16_t keypad);
+// Forgets the newest frame, used when rewinding while recording
+void movie_drop_frame(Movie *movie);
+
+bool movie_save_file(const Movie *movie, const char *path);
+bool movie_load_file(Movie *movie, const char *path);
+
+// Runs the whole movie on a fresh machine as fast as possible, no window, audio
+// or pacing. Returns false when the ROM does not match or the final hash differs.
+// chip8 is reinitialized and has to be chip8_free'd afterwards
+bool movie_replay(const Movie *movie, const uint8_t *rom, size_t rom_size,
+                  Chip8 *chip8, MovieReplayResult *result);
+
+#endif
@@ -0,0 +1,166 @@
+#include <stdio.h>
+#include <string.h>
+
+#include <raylib.h>
+
+#include "host_time.h"
+#include "input.h"
+#include "overlay.h"
+#include "pacing.h"
+
+#define OVERLAY_WIDTH (320)
+#define OVERLAY_HEIGHT (186)
+#define OVERLAY_FONT_SIZE (10)
+#define OVERLAY_REFRESH_NS (500000000ULL)
+
+// Frame time histogram, 2 ms per bucket, the last bucket collects everything slower
+#define HISTOGRAM_BUCKETS (16)
+#define HISTOGRAM_BUCKET_NS (2000000ULL)
+
+PerfCounters perf_counters;
+bool overlay_visible = false;
+
+static RenderTexture2D overlay_texture;
+static bool overlay_loaded = false;
+
+static PerfCounters window_start_counters;
+static uint64_t window_start_ns;
+static uint64_t histogram[HISTOGRAM_BUCKETS];
+static uint64_t window_frame_ns_total;
+static uint64_t window_frame_ns_max;
+static uint64_t window_frames;
+
+void overlay_init(void)
+{
+    overlay_texture = LoadRenderTexture(OVERLAY_WIDTH, OVERLAY_HEIGHT);
+    overlay_loaded = true;
+    window_start_ns = host_time_ns();
+    window_start_counters = perf_counters;
+}
+
+void overlay_unload(void)
+{
+    if (overlay_loaded)
+        UnloadRenderTexture(overlay_texture);
+    overlay_loaded = false;
+}
+
+void overlay_record_frame_time(uint64_t frame_ns)
+{
+    size_t bucket = frame_ns / HISTOGRAM_BUCKET_NS;
+    if (bucket >= HISTOGRAM_BUCKETS)
+        bucket = HISTOGRAM_BUCKETS - 1;
+
+    histogram[bucket]++;
+    window_frame_ns_total += frame_ns;
+    if (frame_ns > window_frame_ns_max)
+        window_frame_ns_max = frame_ns;
+    window_frames++;
+}
+
+static void overlay_render(double elapsed_s)
+{
+    const PerfCounters *now = &perf_counters;
+    const PerfCounters *then = &window_start_counters;
+
+    double instructions_per_s = (now->instructions - then->instructions) / elapsed_s;
+    double real_time_percent = 100.0 * (now->emulated_frames - then->emulated_frames) / (elapsed_s * EMULATION_HZ);
+    uint64_t host_frames = now->host_frames - then->host_frames;
+    double skip_percent = host_frames ? 100.0 * (now->redraws_skipped - then->redraws_skipped) / host_frames : 0.0;
+    double mean_frame_ms = window_frames ? window_frame_ns_total / 1e6 / window_frames : 0.0;
+
+    char line[128];
+
+    BeginTextureMode(overlay_texture);
+    ClearBackground(Fade(BLACK, 0.75f));
+
+    int y = 4;
+    snprintf(line, sizeof(line), "%.0f instr/s  %.1f%% real time", instructions_per_s, real_time_percent);
+    DrawText(line, 4, y, OVERLAY_FONT_SIZE, GREEN);
+    y += OVERLAY_FONT_SIZE + 2;
+    snprintf(line, sizeof(line), "frame %.2f ms avg  %.2f ms max", mean_frame_ms, window_frame_ns_max / 1e6);
+    DrawText(line, 4, y, OVERLAY_FONT_SIZE, GREEN);
+    y += OVERLAY_FONT_SIZE + 2;
+    snprintf(line, sizeof(line), "redraw skipped %.1f%%  audio underruns %llu",
+             skip_percent, (unsigned long long)now->audio_underruns);
+    DrawText(line, 4, y, OVERLAY_FONT_SIZE, GREEN);
+    y += OVERLAY_FONT_SIZE + 2;
+    snprintf(line, sizeof(line), "pacing error %.0f us avg  %.0f us max  %llu missed",
+             pacing_stats.frames ? pacing_stats.error_ns_total / 1e3 / pacing_stats.frames : 0.0,
+             pacing_stats.error_ns_max / 1e3,
+             (unsigned long long)pacing_stats.missed_deadlines);
+    DrawText(line, 4, y, OVERLAY_FONT_SIZE, GREEN);
+    y += OVERLAY_FONT_SIZE + 2;
+    snprintf(line, sizeof(line), "input latency %.2f ms avg  %.2f ms max  %llu mid-tick",
+             input_stats.events ? input_stats.latency_ns_total / 1e6 / input_stats.events : 0.0,
+             input_stats.latency_ns_max / 1e6,
+             (unsigned long long)input_stats.mid_tick);
+    DrawText(line, 4, y, OVERLAY_FONT_SIZE, GREEN);
+    y += OVERLAY_FONT_SIZE + 2;
+
+    uint64_t run_ahead_frames = now->run_ahead_frames - then->run_ahead_frames;
+    if (run_ahead_frames)
+    {
+        snprintf(line, sizeof(line), "run-ahead snapshot %.2f us  run %.2f us  restore %.2f us",
+                 (now->snapshot_ns - then->snapshot_ns) / 1e3 / run_ahead_frames,
+                 (now->run_ahead_ns - then->run_ahead_ns) / 1e3 / run_ahead_frames,
+                 (now->restore_ns - then->restore_ns) / 1e3 / run_ahead_frames);
+    }
+    else
+    {
+        snprintf(line, sizeof(line), "run-ahead off");
+    }
+    DrawText(line, 4, y, OVERLAY_FONT_SIZE, GREEN);
+    y += OVERLAY_FONT_SIZE + 6;
+
+    uint64_t tallest = 1;
+    for (size_t i = 0; i < HISTOGRAM_BUCKETS; i++)
+    {
+        if (histogram[i] > tallest)
+            tallest = histogram[i];
+    }
+
+    const int bar_width = (OVERLAY_WIDTH - 8) / HISTOGRAM_BUCKETS;
+    const int graph_height = OVERLAY_HEIGHT - y - OVERLAY_FONT_SIZE - 6;
+    for (size_t i = 0; i < HISTOGRAM_BUCKETS; i++)
+    {
+        int bar_height = (int)(graph_height * histogram[i] / tallest);
+        DrawRectangle(4 + i * bar_width, y + graph_height - bar_height, bar_width - 1, bar_height, YELLOW);
+    }
+    y += graph_height + 2;
+
+    snprintf(line, sizeof(line), "0 ms%*s%d+ ms", 36, "", (int)(HISTOGRAM_BUCKETS - 1) * 2);
+    DrawText(line, 4, y, OVERLAY_FONT_SIZE, GRAY);
+    EndTextureMode();
+}
+
+void overlay_update(void)
+{
+    if (!overlay_loaded)
+        return;
+
+    uint64_t now_ns = host_time_ns();
+    if (now_ns - window_start_ns < OVERLAY_REFRESH_NS)
+        return;
+
+    // Text is only rebuilt here, every other frame just blits the texture
+    if (overlay_visible)
+        overlay_render((now_ns - window_start_ns) / 1e9);
+
+    window_start_ns = now_ns;
+    window_start_counters = perf_counters;
+    memset(histogram, 0, sizeof(histogram));
+    window_frame_ns_total = 0;
+    window_frame_ns_max = 0;
+    window_frames = 0;
+}
+
+void overlay_draw(void)
+{
+    if (!overlay_loaded || !overlay_visible)
+        return;
+
+    // Render textures are stored upside down
+    Rectangle source = { 0, 0, OVERLAY_WIDTH, -OVERLAY_HEIGHT };
+    DrawTextureRec(overlay_texture.texture, source, (Vector2){ 0, 0 }, WHITE);
+}
@@ -0,0 +1,35 @@
+#ifndef OVERLAY_H
+#define OVERLAY_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Cumulative counters fed by the frontend, the overlay turns them into rates
+typedef struct
+{
+    uint64_t instructions;
+    uint64_t emulated_frames;
+    uint64_t host_frames;
+    uint64_t redraws_skipped;
+    uint64_t audio_underruns;
+    uint64_t run_ahead_frames;
+    uint64_t snapshot_ns;
+    uint64_t run_ahead_ns;
+    uint64_t restore_ns;
+} PerfCounters;
+
+extern PerfCounters perf_counters;
+extern bool overlay_visible;
+
+// Needs a window, call after InitWindow and before CloseWindow respectively
+void overlay_init(void);
+void overlay_unload(void);
+
+void overlay_record_frame_time(uint64_t frame_ns);
+
+// Re-renders the cached text a few times a second, call outside BeginDrawing
+void overlay_update(void);
+// Blits the cached overlay, call between BeginDrawing and EndDrawing
+void overlay_draw(void);
+
+#endif
@@ -0,0 +1,170 @@
+#include <stdio.h>
+#include <time.h>
+
+#include "host_time.h"
+#include "pacing.h"
+
+#define NS_PER_SECOND (1000000000ULL)
+
+// Bounds for the spin window at the end of each frame
+#define PACING_MIN_SPIN_NS (200000ULL)
+#define PACING_MAX_SPIN_NS (4000000ULL)
+
+PacingStats pacing_stats;
+
+static uint32_t pacing_host_hz;
+static uint64_t host_origin_ns;
+static uint64_t host_frame_index;
+
+static uint64_t emulation_origin_ns;
+static uint64_t emulation_ticks_done;
+
+// Running average of how far past the requested time nanosleep returns
+static uint64_t sleep_overshoot_ns = PACING_MIN_SPIN_NS;
+
+static void (*poll_callback)(void);
+
+void pacing_init(uint32_t host_hz)
+{
+    pacing_host_hz = host_hz ? host_hz : EMULATION_HZ;
+
+    uint64_t now = host_time_ns();
+    host_origin_ns = now;
+    host_frame_index = 0;
+
+    // Sample the emulated clock half a tick off the host frame boundaries, so when
+    // the display runs at a multiple of 60 Hz scheduling noise can't make a frame
+    // see 0 ticks and the next one 2
+    emulation_origin_ns = now - NS_PER_SECOND / EMULATION_HZ / 2;
+    emulation_ticks_done = 0;
+}
+
+uint32_t pacing_emulation_ticks_due(void)
+{
+    uint64_t elapsed_ns = host_time_ns() - emulation_origin_ns;
+    uint64_t ticks = elapsed_ns * EMULATION_HZ / NS_PER_SECOND;
+    uint64_t due = ticks - emulation_ticks_done;
+
+    if (due > PACING_MAX_TICKS_PER_FRAME)
+    {
+        pacing_stats.dropped_ticks += due - PACING_MAX_TICKS_PER_FRAME;
+        emulation_ticks_done = ticks - PACING_MAX_TICKS_PER_FRAME;
+        due = PACING_MAX_TICKS_PER_FRAME;
+    }
+
+    emulation_ticks_done += due;
+    return (uint32_t)due;
+}
+
+uint64_t pacing_ticks_done(void)
+{
+    return emulation_ticks_done;
+}
+
+uint64_t pacing_emulated_position(uint64_t host_ns)
+{
+    if (host_ns < emulation_origin_ns)
+        return 0;
+
+    // Split so the multiplication can't overflow even after days
+    uint64_t scaled = (host_ns - emulation_origin_ns) * EMULATION_HZ;
+    uint64_t ticks = scaled / NS_PER_SECOND;
+    uint64_t fraction = (scaled % NS_PER_SECOND << PACING_TICK_FRACTION_BITS) / NS_PER_SECOND;
+    return ticks << PACING_TICK_FRACTION_BITS | fraction;
+}
+
+void pacing_set_poll(void (*poll)(void))
+{
+    poll_callback = poll;
+}
+
+static uint64_t host_deadline_ns(uint64_t frame_index)
+{
+    // Computed from the origin every time so 1/144 s rounding never accumulates
+    return host_origin_ns + frame_index * NS_PER_SECOND / pacing_host_hz;
+}
+
+static void sleep_ns(uint64_t duration_ns)
+{
+    struct timespec request = {
+        .tv_sec = duration_ns / NS_PER_SECOND,
+        .tv_nsec = duration_ns % NS_PER_SECOND,
+    };
+    nanosleep(&request, NULL);
+}
+
+void pacing_wait_for_next_frame(void)
+{
+    uint64_t deadline = host_deadline_ns(host_frame_index + 1);
+    uint64_t now = host_time_ns();
+
+    if (now > deadline + NS_PER_SECOND / pacing_host_hz)
+    {
+        // More than a whole frame late, start a fresh schedule from here
+        pacing_stats.missed_deadlines++;
+        host_origin_ns = now;
+        host_frame_index = 0;
+        pacing_stats.frames++;
+        return;
+    }
+
+    uint64_t spin_ns = 2 * sleep_overshoot_ns;
+    if (spin_ns < PACING_MIN_SPIN_NS)
+        spin_ns = PACING_MIN_SPIN_NS;
+    if (spin_ns > PACING_MAX_SPIN_NS)
+        spin_ns = PACING_MAX_SPIN_NS;
+
+    // Sleep in slices no longer than the poll interval, so the callback keeps running
+    while (deadline > now + spin_ns)
+    {
+        uint64_t wake_target = deadline - spin_ns;
+        if (poll_callback != NULL && wake_target > now + PACING_POLL_INTERVAL_NS)
+            wake_target = now + PACING_POLL_INTERVAL_NS;
+        sleep_ns(wake_target - now);
+
+        uint64_t woke = host_time_ns();
+        uint64_t overshoot = woke > wake_target ? woke - wake_target : 0;
+        sleep_overshoot_ns = (7 * sleep_overshoot_ns + overshoot) / 8;
+        pacing_stats.sleep_ns_total += woke - now;
+        if (poll_callback != NULL)
+            poll_callback();
+        now = host_time_ns();
+    }
+
+    uint64_t spin_start = now;
+    uint64_t last_poll = now;
+    while (now < deadline)
+    {
+        now = host_time_ns();
+        if (poll_callback != NULL && now - last_poll >= PACING_POLL_INTERVAL_NS)
+        {
+            poll_callback();
+            last_poll = now;
+        }
+    }
+    pacing_stats.spin_ns_total += now - spin_start;
+
+    uint64_t error_ns = now - deadline;
+    pacing_stats.error_ns_total += error_ns;
+    if (error_ns > pacing_stats.error_ns_max)
+        pacing_stats.error_ns_max = error_ns;
+    pacing_stats.frames++;
+
+    host_frame_index++;
+}
+
+void pacing_print_stats(void)
+{
+    if (pacing_stats.frames == 0)
+        return;
+
+    printf("Pacing: %llu frames at %u Hz, error %.1f us avg %.1f us max, %llu missed deadlines, %llu dropped ticks\n",
+           (unsigned long long)pacing_stats.frames,
+           pacing_host_hz,
+           pacing_stats.error_ns_total / 1e3 / pacing_stats.frames,
+           pacing_stats.error_ns_max / 1e3,
+           (unsigned long long)pacing_stats.missed_deadlines,
+           (unsigned long long)pacing_stats.dropped_ticks);
+    printf("Pacing: %.1f%% of wait time spent spinning\n",
+           100.0 * pacing_stats.spin_ns_total / (pacing_stats.spin_ns_total + pacing_stats.sleep_ns_total + 1));
+}
@@ -0,0 +1,53 @@
+#ifndef PACING_H
+#define PACING_H
+
+#include <stdint.h>
+
+// Emulated time always advances at exactly this rate, whatever the display does
+#define EMULATION_HZ (60U)
+
+// Upper bound on ticks run in one host frame, anything beyond that (window drag,
+// debugger stop) is dropped instead of fast-forwarding to catch up
+#define PACING_MAX_TICKS_PER_FRAME (4U)
+
+// While waiting for the next frame the poll callback runs about this often
+#define PACING_POLL_INTERVAL_NS (1000000ULL)
+
+// Emulated positions carry this many fractional bits below the tick number
+#define PACING_TICK_FRACTION_BITS (16U)
+
+typedef struct
+{
+    uint64_t frames;
+    uint64_t missed_deadlines;
+    uint64_t error_ns_total;
+    uint64_t error_ns_max;
+    uint64_t sleep_ns_total;
+    uint64_t spin_ns_total;
+    uint64_t dropped_ticks;
+} PacingStats;
+
+extern PacingStats pacing_stats;
+
+void pacing_init(uint32_t host_hz);
+
+// Number of EMULATION_HZ ticks that became due since the last call
+uint32_t pacing_emulation_ticks_due(void);
+
+// Ticks handed out so far, the ticks of the last pacing_emulation_ticks_due call end here
+uint64_t pacing_ticks_done(void);
+
+// Where the emulated clock stood at a host time, in ticks since pacing_init with
+// PACING_TICK_FRACTION_BITS of fraction
+uint64_t pacing_emulated_position(uint64_t host_ns);
+
+// Called repeatedly from pacing_wait_for_next_frame, e.g. to sample input between frames
+void pacing_set_poll(void (*poll)(void));
+
+// Sleeps for most of the time left until the next host frame deadline and spins
+// for the remainder, the spin window adapts to how late the OS wakes us up
+void pacing_wait_for_next_frame(void);
+
+void pacing_print_stats(void);
+
+#endif
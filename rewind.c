@@ -0,0 +1,311 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "rewind.h"
+#include "savestate.h"
+
+// A varint of a size_t takes at most this many bytes
+#define REWIND_VARINT_MAX_SIZE ((sizeof(size_t) * 8 + 6) / 7)
+
+// Enough for the newest keyframe group to always fit next to the record being
+// pushed, even with the space wasted when allocation wraps around. A delta that
+// would grow as big as its state is stored as a keyframe instead, so no record
+// is bigger than a save state
+#define REWIND_MIN_CAPACITY(state_size) (2 * (REWIND_KEYFRAME_INTERVAL + 2) * (state_size))
+
+typedef struct
+{
+    uint32_t offset;
+    uint32_t size;
+    bool keyframe;
+} RewindRecord;
+
+static uint8_t *arena;
+static size_t arena_capacity;
+static size_t arena_head;
+static size_t arena_used;
+
+// Ring of records, oldest first. The oldest record is always a keyframe
+static RewindRecord *records;
+static size_t record_capacity;
+static size_t record_first;
+static size_t record_count;
+
+// Serialized form of the newest recorded frame, the base for the next delta. Every
+// record of a group has the size of its keyframe, a new platform starts a new group
+static uint8_t newest_state[SAVESTATE_SIZE];
+static size_t newest_size;
+static size_t newest_group_length;
+
+static RewindRecord *record_at(size_t index)
+{
+    return &records[(record_first + index) % record_capacity];
+}
+
+bool rewind_init(size_t capacity, const Chip8 *chip8)
+{
+    size_t min_capacity = REWIND_MIN_CAPACITY(savestate_size(chip8));
+    if (capacity < min_capacity)
+    {
+        fprintf(stderr, "Rewind history needs at least %.1f MB on %s, using that instead of %.1f MB\n",
+                min_capacity / (1024.0 * 1024), chip8_platform_name(chip8->platform), capacity / (1024.0 * 1024));
+        capacity = min_capacity;
+    }
+
+    arena = malloc(capacity);
+    record_capacity = capacity / 16;
+    records = calloc(record_capacity, sizeof(RewindRecord));
+    if (arena == NULL || records == NULL)
+    {
+        fprintf(stderr, "Could not allocate %zu bytes of rewind history\n", capacity);
+        rewind_free();
+        return false;
+    }
+
+    arena_capacity = capacity;
+    arena_head = 0;
+    arena_used = 0;
+    record_first = 0;
+    record_count = 0;
+    newest_group_length = 0;
+    return true;
+}
+
+void rewind_free(void)
+{
+    free(arena);
+    free(records);
+    arena = NULL;
+    records = NULL;
+    record_count = 0;
+}
+
+static size_t put_varint(uint8_t *out, size_t value)
+{
+    size_t n = 0;
+    while (value >= 0x80)
+    {
+        out[n++] = (value & 0x7F) | 0x80;
+        value >>= 7;
+    }
+    out[n++] = value;
+    return n;
+}
+
+static size_t get_varint(const uint8_t *in, size_t *value)
+{
+    size_t n = 0;
+    size_t shift = 0;
+    *value = 0;
+    do
+    {
+        *value |= (size_t)(in[n] & 0x7F) << shift;
+        shift += 7;
+    } while (in[n++] & 0x80);
+    return n;
+}
+
+// XOR of the two states as (zero run, literal run, literal bytes) triples. Frames
+// barely differ so almost everything collapses into zero runs, trailing zeros are implied.
+// Scattered changes cost two varints each, so a delta can outgrow the state: out holds
+// size bytes, and the encoding stops and returns size once the delta would reach it
+static size_t delta_encode(const uint8_t *previous, const uint8_t *current, size_t size, uint8_t *out)
+{
+    size_t n = 0;
+    size_t pos = 0;
+    while (pos < size)
+    {
+        size_t zero_start = pos;
+        while (pos < size && previous[pos] == current[pos])
+            pos++;
+        if (pos == size)
+            break;
+
+        size_t literal_start = pos;
+        while (pos < size && previous[pos] != current[pos])
+            pos++;
+
+        uint8_t header[2 * REWIND_VARINT_MAX_SIZE];
+        size_t header_size = put_varint(header, literal_start - zero_start);
+        header_size += put_varint(header + header_size, pos - literal_start);
+        if (n + header_size + (pos - literal_start) >= size)
+            return size;
+
+        memcpy(out + n, header, header_size);
+        n += header_size;
+        for (size_t i = literal_start; i < pos; i++)
+        {
+            out[n++] = previous[i] ^ current[i];
+        }
+    }
+    return n;
+}
+
+// XOR is its own inverse, so the same walk moves a state either forwards or backwards
+static void delta_apply(uint8_t *state, const uint8_t *delta, size_t size)
+{
+    size_t n = 0;
+    size_t pos = 0;
+    while (n < size)
+    {
+        size_t zeros, literals;
+        n += get_varint(delta + n, &zeros);
+        n += get_varint(delta + n, &literals);
+        pos += zeros;
+        for (size_t i = 0; i < literals; i++)
+        {
+            state[pos++] ^= delta[n++];
+        }
+    }
+}
+
+static void evict_oldest_group(void)
+{
+    do
+    {
+        arena_used -= record_at(0)->size;
+        record_first = (record_first + 1) % record_capacity;
+        record_count--;
+    } while (record_count > 0 && !record_at(0)->keyframe);
+}
+
+static bool ranges_overlap(size_t a, size_t a_size, size_t b, size_t b_size)
+{
+    return a < b + b_size && b < a + a_size;
+}
+
+static size_t rewind_allocate(size_t size)
+{
+    if (record_count == record_capacity)
+        evict_oldest_group();
+
+    size_t offset = arena_head;
+    if (offset + size > arena_capacity)
+    {
+        // Wrap to the start. Whatever sits between the head and the end of the
+        // arena is older than what is at the start, so it has to go first
+        while (record_count > 0 && record_at(0)->offset >= arena_head)
+            evict_oldest_group();
+        offset = 0;
+    }
+
+    while (record_count > 0 && ranges_overlap(offset, size, record_at(0)->offset, record_at(0)->size))
+        evict_oldest_group();
+
+    arena_head = offset + size;
+    return offset;
+}
+
+static void rewind_append(const uint8_t *data, size_t size, bool keyframe)
+{
+    size_t offset = rewind_allocate(size);
+    memcpy(arena + offset, data, size);
+
+    RewindRecord *record = record_at(record_count);
+    record->offset = offset;
+    record->size = size;
+    record->keyframe = keyframe;
+    record_count++;
+    arena_used += size;
+}
+
+void rewind_push(const Chip8 *chip8)
+{
+    if (arena == NULL)
+        return;
+
+    // Static, an XO-CHIP state is too big for some stacks
+    static uint8_t state[SAVESTATE_SIZE];
+    static uint8_t delta[SAVESTATE_SIZE];
+    size_t state_size = savestate_write(chip8, state);
+
+    size_t delta_size = state_size;
+    if (record_count > 0 && newest_group_length < REWIND_KEYFRAME_INTERVAL && state_size == newest_size)
+        delta_size = delta_encode(newest_state, state, state_size, delta);
+
+    // A delta no smaller than the state saves nothing, the frame starts a new group
+    if (delta_size == state_size)
+    {
+        rewind_append(state, state_size, true);
+        newest_group_length = 1;
+    }
+    else
+    {
+        rewind_append(delta, delta_size, false);
+        newest_group_length++;
+
+        if (record_count == 1)
+        {
+            // The arena was too small to keep the keyframe this delta is based on
+            record_count = 0;
+            arena_used = 0;
+            rewind_append(state, state_size, true);
+            newest_group_length = 1;
+        }
+    }
+
+    memcpy(newest_state, state, state_size);
+    newest_size = state_size;
+}
+
+// Rebuilds the full state of record index from the keyframe starting its group,
+// returns the size of the state
+static size_t rewind_rebuild(size_t index, uint8_t *state)
+{
+    size_t keyframe = index;
+    while (!record_at(keyframe)->keyframe)
+        keyframe--;
+
+    size_t size = record_at(keyframe)->size;
+    memcpy(state, arena + record_at(keyframe)->offset, size);
+    for (size_t i = keyframe + 1; i <= index; i++)
+    {
+        const RewindRecord *record = record_at(i);
+        delta_apply(state, arena + record->offset, record->size);
+    }
+    return size;
+}
+
+bool rewind_step_back(Chip8 *chip8)
+{
+    if (record_count < 2)
+        return false;
+
+    RewindRecord *newest = record_at(record_count - 1);
+    if (newest->keyframe)
+    {
+        // Crossing into the previous group, replay it forward from its keyframe
+        newest_size = rewind_rebuild(record_count - 2, newest_state);
+    }
+    else
+    {
+        delta_apply(newest_state, arena + newest->offset, newest->size);
+    }
+
+    // The newest record is always the last allocation, so its space can be reused
+    arena_head = newest->offset;
+    arena_used -= newest->size;
+    record_count--;
+
+    newest_group_length = 0;
+    for (size_t i = record_count; i-- > 0;)
+    {
+        newest_group_length++;
+        if (record_at(i)->keyframe)
+            break;
+    }
+
+    return savestate_read(chip8, newest_state, newest_size);
+}
+
+size_t rewind_frame_count(void)
+{
+    return record_count;
+}
+
+size_t rewind_bytes_used(void)
+{
+    return arena_used;
+}
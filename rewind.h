@@ -0,0 +1,31 @@
+#ifndef REWIND_H
+#define REWIND_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "chip8.h"
+
+#define REWIND_DEFAULT_CAPACITY (4U * 1024 * 1024)
+
+// Every this many frames a full save state is stored, the frames in between are
+// kept as run-length encoded XOR deltas against the frame before them
+#define REWIND_KEYFRAME_INTERVAL (60U)
+
+// History lives in a fixed arena of capacity bytes, the oldest frames are dropped
+// (a whole keyframe group at a time) when it runs out. The arena has to hold a whole
+// keyframe group of chip8's save states, a smaller capacity is raised with a warning
+bool rewind_init(size_t capacity, const Chip8 *chip8);
+void rewind_free(void);
+
+// Records the machine as the newest frame of history, call once per emulated frame
+void rewind_push(const Chip8 *chip8);
+
+// Moves the machine back to the frame before the newest one and forgets the newest,
+// returns false once the start of the recorded history is reached
+bool rewind_step_back(Chip8 *chip8);
+
+size_t rewind_frame_count(void);
+size_t rewind_bytes_used(void);
+
+#endif
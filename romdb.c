@@ -0,0 +1,247 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "romdb.h"
+
+#define ROMDB_HEADER_SIZE (4 + 2 + 2 + 4)
+#define ROMDB_ENTRY_SIZE (8 + 1 + 1 + 2)
+
+static const uint8_t *get_u16(const uint8_t *in, uint16_t *value)
+{
+    *value = (uint16_t)in[0] | ((uint16_t)in[1] << 8);
+    return in + 2;
+}
+
+static const uint8_t *get_u32(const uint8_t *in, uint32_t *value)
+{
+    uint16_t low, high;
+    in = get_u16(in, &low);
+    in = get_u16(in, &high);
+    *value = (uint32_t)low | ((uint32_t)high << 16);
+    return in;
+}
+
+static const uint8_t *get_u64(const uint8_t *in, uint64_t *value)
+{
+    uint32_t low, high;
+    in = get_u32(in, &low);
+    in = get_u32(in, &high);
+    *value = (uint64_t)low | ((uint64_t)high << 32);
+    return in;
+}
+
+static uint32_t rotate_left(uint32_t value, uint32_t bits)
+{
+    return value << bits | value >> (32 - bits);
+}
+
+static void sha1_block(uint32_t state[5], const uint8_t block[64])
+{
+    uint32_t w[80];
+    for (size_t i = 0; i < 16; i++)
+    {
+        w[i] = (uint32_t)block[4 * i] << 24 | (uint32_t)block[4 * i + 1] << 16
+               | (uint32_t)block[4 * i + 2] << 8 | block[4 * i + 3];
+    }
+    for (size_t i = 16; i < 80; i++)
+    {
+        w[i] = rotate_left(w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16], 1);
+    }
+
+    uint32_t a = state[0], b = state[1], c = state[2], d = state[3], e = state[4];
+    for (size_t i = 0; i < 80; i++)
+    {
+        uint32_t f, k;
+        if (i < 20)
+        {
+            f = (b & c) | (~b & d);
+            k = 0x5A827999;
+        }
+        else if (i < 40)
+        {
+            f = b ^ c ^ d;
+            k = 0x6ED9EBA1;
+        }
+        else if (i < 60)
+        {
+            f = (b & c) | (b & d) | (c & d);
+            k = 0x8F1BBCDC;
+        }
+        else
+        {
+            f = b ^ c ^ d;
+            k = 0xCA62C1D6;
+        }
+
+        uint32_t temp = rotate_left(a, 5) + f + e + k + w[i];
+        e = d;
+        d = c;
+        c = rotate_left(b, 30);
+        b = a;
+        a = temp;
+    }
+
+    state[0] += a;
+    state[1] += b;
+    state[2] += c;
+    state[3] += d;
+    state[4] += e;
+}
+
+void romdb_sha1(const uint8_t *data, size_t size, uint8_t digest[20])
+{
+    uint32_t state[5] = { 0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476, 0xC3D2E1F0 };
+
+    size_t full_blocks = size / 64;
+    for (size_t i = 0; i < full_blocks; i++)
+    {
+        sha1_block(state, data + 64 * i);
+    }
+
+    // The rest, a single 1 bit, zeros and the length in bits, in one or two blocks
+    uint8_t tail[128] = { 0 };
+    size_t rest = size % 64;
+    memcpy(tail, data + 64 * full_blocks, rest);
+    tail[rest] = 0x80;
+    size_t tail_size = rest < 56 ? 64 : 128;
+    uint64_t bits = (uint64_t)size * 8;
+    for (size_t i = 0; i < 8; i++)
+    {
+        tail[tail_size - 1 - i] = bits >> (8 * i);
+    }
+    for (size_t offset = 0; offset < tail_size; offset += 64)
+    {
+        sha1_block(state, tail + offset);
+    }
+
+    for (size_t i = 0; i < 20; i++)
+    {
+        digest[i] = state[i / 4] >> (24 - 8 * (i % 4));
+    }
+}
+
+uint64_t romdb_key(const uint8_t *rom, size_t size)
+{
+    uint8_t digest[20];
+    romdb_sha1(rom, size, digest);
+
+    uint64_t key = 0;
+    for (size_t i = 0; i < 8; i++)
+    {
+        key = key << 8 | digest[i];
+    }
+    return key;
+}
+
+bool romdb_load_file(RomDb *db, const char *path)
+{
+    memset(db, 0, sizeof(*db));
+
+    FILE *file = fopen(path, "rb");
+    if (file == NULL)
+    {
+        fprintf(stderr, "Could not open ROM database %s\n", path);
+        return false;
+    }
+
+    uint8_t header[ROMDB_HEADER_SIZE];
+    uint16_t version = 0;
+    if (fread(header, 1, sizeof(header), file) != sizeof(header)
+        || memcmp(header, ROMDB_MAGIC, 4) != 0)
+    {
+        fprintf(stderr, "%s is not a ROM database\n", path);
+        fclose(file);
+        return false;
+    }
+
+    uint32_t entry_count;
+    const uint8_t *in = get_u16(header + 4, &version);
+    get_u32(in + 2, &entry_count);
+    if (version != ROMDB_VERSION)
+    {
+        fprintf(stderr, "Unsupported ROM database version %u\n", version);
+        fclose(file);
+        return false;
+    }
+
+    size_t size = (size_t)entry_count * ROMDB_ENTRY_SIZE;
+    uint8_t *entries = malloc(size ? size : 1);
+    if (entries == NULL)
+    {
+        fprintf(stderr, "Could not allocate %zu bytes for ROM database %s\n", size, path);
+        fclose(file);
+        return false;
+    }
+
+    // One extra byte read catches trailing garbage
+    uint8_t extra;
+    bool ok = fread(entries, 1, size, file) == size && fread(&extra, 1, 1, file) == 0;
+    fclose(file);
+
+    // The binary search needs strictly ascending keys, and every entry has to be usable
+    uint64_t previous = 0;
+    for (size_t i = 0; ok && i < entry_count; i++)
+    {
+        const uint8_t *entry = entries + i * ROMDB_ENTRY_SIZE;
+        uint64_t key;
+        uint16_t instructions_per_frame;
+        get_u16(get_u64(entry, &key) + 2, &instructions_per_frame);
+        ok = (i == 0 || key > previous)
+             && entry[8] < CHIP8_PLATFORM_COUNT
+             && entry[9] < CHIP8_QUIRK_COMBINATIONS
+             && instructions_per_frame > 0;
+        previous = key;
+    }
+    if (!ok)
+    {
+        fprintf(stderr, "ROM database %s is corrupt\n", path);
+        free(entries);
+        return false;
+    }
+
+    db->entries = entries;
+    db->entry_count = entry_count;
+    return true;
+}
+
+void romdb_free(RomDb *db)
+{
+    free(db->entries);
+    db->entries = NULL;
+    db->entry_count = 0;
+}
+
+bool romdb_lookup(const RomDb *db, const uint8_t *rom, size_t size, RomInfo *info)
+{
+    uint64_t key = romdb_key(rom, size);
+
+    size_t low = 0;
+    size_t high = db->entry_count;
+    while (low < high)
+    {
+        size_t middle = low + (high - low) / 2;
+        const uint8_t *entry = db->entries + middle * ROMDB_ENTRY_SIZE;
+        uint64_t entry_key;
+        get_u64(entry, &entry_key);
+
+        if (entry_key < key)
+        {
+            low = middle + 1;
+        }
+        else if (entry_key > key)
+        {
+            high = middle;
+        }
+        else
+        {
+            uint16_t instructions_per_frame;
+            get_u16(entry + 10, &instructions_per_frame);
+            info->platform = entry[8];
+            info->quirks = entry[9];
+            info->instructions_per_frame = instructions_per_frame;
+            return true;
+        }
+    }
+    return false;
+}
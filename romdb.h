@@ -0,0 +1,42 @@
+#ifndef ROMDB_H
+#define ROMDB_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "chip8.h"
+
+// Per-ROM settings index, generated from the community CHIP-8 database with
+// romdb.py. Binary layout, all multi-byte fields little endian:
+//   "C8DB" magic, u16 version, u16 reserved, u32 entry_count,
+//   entry_count * (u64 key, u8 platform, u8 quirks, u16 instructions_per_frame)
+// Entries are sorted by key, the first 8 bytes of the ROM's SHA-1 read big endian
+// (the database identifies ROMs by SHA-1), so a lookup is a binary search
+#define ROMDB_MAGIC "C8DB"
+#define ROMDB_VERSION (1U)
+#define ROMDB_DEFAULT_PATH "roms/romdb.bin"
+
+typedef struct
+{
+    Chip8Platform platform;
+    uint8_t quirks;
+    uint32_t instructions_per_frame;
+} RomInfo;
+
+typedef struct
+{
+    uint8_t *entries;
+    size_t entry_count;
+} RomDb;
+
+bool romdb_load_file(RomDb *db, const char *path);
+void romdb_free(RomDb *db);
+
+void romdb_sha1(const uint8_t *data, size_t size, uint8_t digest[20]);
+uint64_t romdb_key(const uint8_t *rom, size_t size);
+
+// False when the ROM is not in the index
+bool romdb_lookup(const RomDb *db, const uint8_t *rom, size_t size, RomInfo *info);
+
+#endif
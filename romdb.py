@@ -0,0 +1,105 @@
+#!/usr/bin/env python3
+# Builds the ROM settings index romdb.c reads from the community CHIP-8 database
+# (https://github.com/chip-8/chip-8-database):
+#
+#   python3 romdb.py chip-8-database/database roms/romdb.bin
+#
+# Each ROM gets the first platform in its list that this emulator runs, that
+# platform's quirks with the ROM's own overrides applied, and the ROM's tickrate
+# (instructions per frame) or else the platform's default. ROMs that only run on
+# platforms the emulator lacks are left out.
+
+import json
+import os
+import struct
+import sys
+
+MAGIC = b"C8DB"
+VERSION = 1
+
+# Chip8Platform in chip8.h
+PLATFORM_CHIP8 = 0
+PLATFORM_SCHIP = 1
+PLATFORM_XOCHIP = 2
+
+PLATFORMS = {
+    "originalChip8": PLATFORM_CHIP8,
+    "hybridVIP": PLATFORM_CHIP8,
+    "modernChip8": PLATFORM_CHIP8,
+    "chip48": PLATFORM_SCHIP,
+    "superchip1": PLATFORM_SCHIP,
+    "superchip": PLATFORM_SCHIP,
+    "xochip": PLATFORM_XOCHIP,
+}
+
+# Chip8Quirk in chip8.h, keyed by the database's quirk names. The database names the
+# behavior that deviates the other way for some of them, hence the inverted flag
+QUIRK_SHIFT_VY = 1 << 0
+QUIRK_MEMORY_INCREMENT_I = 1 << 1
+QUIRK_JUMP_VX = 1 << 2
+QUIRK_VF_RESET = 1 << 3
+QUIRK_CLIP = 1 << 4
+QUIRK_DISPLAY_WAIT = 1 << 5
+
+QUIRKS = {
+    "shift": (QUIRK_SHIFT_VY, True),
+    # memoryIncrementByX leaves I one short of the usual increment, the nearest is incrementing
+    "memoryLeaveIUnchanged": (QUIRK_MEMORY_INCREMENT_I, True),
+    "jump": (QUIRK_JUMP_VX, False),
+    "logic": (QUIRK_VF_RESET, False),
+    "wrap": (QUIRK_CLIP, True),
+    "vblank": (QUIRK_DISPLAY_WAIT, False),
+}
+
+DEFAULT_TICKRATE = 15
+
+
+def quirk_bits(quirks):
+    bits = 0
+    for name, (bit, inverted) in QUIRKS.items():
+        if bool(quirks.get(name, inverted)) != inverted:
+            bits |= bit
+    return bits
+
+
+def main():
+    if len(sys.argv) != 3:
+        sys.exit("usage: romdb.py <database dir> <output>")
+    database, output = sys.argv[1:]
+
+    with open(os.path.join(database, "platforms.json")) as f:
+        platforms = {platform["id"]: platform for platform in json.load(f)}
+    with open(os.path.join(database, "programs.json")) as f:
+        programs = json.load(f)
+
+    entries = {}
+    skipped = 0
+    for program in programs:
+        for sha1, rom in program.get("roms", {}).items():
+            supported = [p for p in rom.get("platforms", []) if p in PLATFORMS and p in platforms]
+            if not supported:
+                skipped += 1
+                continue
+
+            platform_id = supported[0]
+            platform = platforms[platform_id]
+            quirks = dict(platform.get("quirks", {}))
+            quirks.update(rom.get("quirkyPlatforms", {}).get(platform_id, {}))
+            tickrate = rom.get("tickrate", platform.get("defaultTickrate", DEFAULT_TICKRATE))
+
+            key = int(sha1[:16], 16)
+            if key in entries:
+                skipped += 1
+                continue
+            entries[key] = (PLATFORMS[platform_id], quirk_bits(quirks), max(1, min(int(tickrate), 0xFFFF)))
+
+    with open(output, "wb") as f:
+        f.write(MAGIC + struct.pack("<HHI", VERSION, 0, len(entries)))
+        for key in sorted(entries):
+            f.write(struct.pack("<QBBH", key, *entries[key]))
+
+    print(f"{len(entries)} ROMs written to {output}, {skipped} skipped")
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,249 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "savestate.h"
+
+static uint8_t *put_u16(uint8_t *out, uint16_t value)
+{
+    out[0] = value & 0xFF;
+    out[1] = value >> 8;
+    return out + 2;
+}
+
+static uint8_t *put_u32(uint8_t *out, uint32_t value)
+{
+    out = put_u16(out, value & 0xFFFF);
+    return put_u16(out, value >> 16);
+}
+
+static const uint8_t *get_u16(const uint8_t *in, uint16_t *value)
+{
+    *value = (uint16_t)in[0] | ((uint16_t)in[1] << 8);
+    return in + 2;
+}
+
+static const uint8_t *get_u32(const uint8_t *in, uint32_t *value)
+{
+    uint16_t low, high;
+    in = get_u16(in, &low);
+    in = get_u16(in, &high);
+    *value = (uint32_t)low | ((uint32_t)high << 16);
+    return in;
+}
+
+// Big endian, so the leftmost pixel ends up in the MSB of the first byte
+static uint8_t *put_display_word(uint8_t *out, uint64_t word)
+{
+    for (size_t i = 0; i < 8; i++)
+    {
+        out[i] = word >> (56 - 8 * i);
+    }
+    return out + 8;
+}
+
+static const uint8_t *get_display_word(const uint8_t *in, uint64_t *word)
+{
+    *word = 0;
+    for (size_t i = 0; i < 8; i++)
+    {
+        *word = *word << 8 | in[i];
+    }
+    return in + 8;
+}
+
+// Planes, rows and 64 pixel words per row of the display the platform can light,
+// plain CHIP-8 never leaves low resolution and only XO-CHIP draws on plane 1
+static void display_extent(Chip8Platform platform, size_t *planes, size_t *rows, size_t *words)
+{
+    *planes = platform == CHIP8_PLATFORM_XOCHIP ? CHIP8_PLANE_COUNT : 1;
+    *rows = platform == CHIP8_PLATFORM_CHIP8 ? HEIGHT : CHIP8_HIRES_HEIGHT;
+    *words = platform == CHIP8_PLATFORM_CHIP8 ? 1 : CHIP8_DISPLAY_WORDS;
+}
+
+static size_t platform_size(Chip8Platform platform)
+{
+    size_t planes, rows, words;
+    display_extent(platform, &planes, &rows, &words);
+    return SAVESTATE_FIXED_SIZE + chip8_platform_memory_size(platform) + planes * rows * words * 8;
+}
+
+size_t savestate_size(const Chip8 *chip8)
+{
+    return platform_size(chip8->platform);
+}
+
+size_t savestate_write(const Chip8 *chip8, uint8_t *buffer)
+{
+    uint8_t *out = buffer;
+
+    memcpy(out, SAVESTATE_MAGIC, 4);
+    out = put_u16(out + 4, SAVESTATE_VERSION);
+    out = put_u16(out, chip8->platform);
+
+    memcpy(out, CHIP8_MEMORY(chip8), chip8_memory_size(chip8));
+    out += chip8_memory_size(chip8);
+    memcpy(out, chip8->registers.V, 16);
+    out += 16;
+    out = put_u16(out, chip8->I);
+    for (size_t i = 0; i < CHIP8_STACK_SIZE; i++)
+    {
+        out = put_u16(out, chip8->stack.stack_arr[i]);
+    }
+    *out++ = chip8->stack.stack_pointer;
+    out = put_u16(out, chip8->program_counter);
+    out = put_u16(out, chip8->delay_timer);
+    out = put_u16(out, chip8->sound_timer);
+    out = put_u32(out, chip8->rng_state);
+    memcpy(out, chip8->audio_pattern, CHIP8_AUDIO_PATTERN_SIZE);
+    out += CHIP8_AUDIO_PATTERN_SIZE;
+    *out++ = chip8->pitch;
+
+    *out++ = chip8->hires;
+    *out++ = chip8->planes;
+    memcpy(out, chip8->rpl, CHIP8_FLAG_REGISTER_COUNT);
+    out += CHIP8_FLAG_REGISTER_COUNT;
+    *out++ = chip8->quirks;
+    *out++ = chip8->vblank;
+
+    size_t planes, rows, words;
+    display_extent(chip8->platform, &planes, &rows, &words);
+    for (size_t plane = 0; plane < planes; plane++)
+    {
+        for (size_t y = 0; y < rows; y++)
+        {
+            for (size_t word = 0; word < words; word++)
+            {
+                out = put_display_word(out, chip8->display[plane][y][word]);
+            }
+        }
+    }
+
+    return out - buffer;
+}
+
+bool savestate_read(Chip8 *chip8, const uint8_t *buffer, size_t size)
+{
+    if (size < SAVESTATE_HEADER_SIZE || memcmp(buffer, SAVESTATE_MAGIC, 4) != 0)
+    {
+        fprintf(stderr, "Not a chip8 save state\n");
+        return false;
+    }
+
+    uint16_t version, platform;
+    const uint8_t *in = get_u16(buffer + 4, &version);
+    in = get_u16(in, &platform);
+    if (version != SAVESTATE_VERSION)
+    {
+        fprintf(stderr, "Unsupported save state version %u\n", version);
+        return false;
+    }
+    if (platform >= CHIP8_PLATFORM_COUNT || size != platform_size(platform))
+    {
+        fprintf(stderr, "Not a chip8 save state\n");
+        return false;
+    }
+
+    // Decode into a scratch machine so a bad blob can't leave chip8 half loaded. Static,
+    // so an XO-CHIP state reuses the memory block the last one allocated
+    static Chip8 loaded;
+    chip8_copy(&loaded, chip8);
+
+    size_t memory_size = chip8_platform_memory_size(platform);
+    chip8_resize_memory(&loaded, memory_size);
+    memcpy(CHIP8_MEMORY(&loaded), in, memory_size);
+    in += memory_size;
+    memcpy(loaded.registers.V, in, 16);
+    in += 16;
+    in = get_u16(in, &loaded.I);
+    for (size_t i = 0; i < CHIP8_STACK_SIZE; i++)
+    {
+        in = get_u16(in, &loaded.stack.stack_arr[i]);
+    }
+    loaded.stack.stack_pointer = *in++;
+    in = get_u16(in, &loaded.program_counter);
+    in = get_u16(in, &loaded.delay_timer);
+    in = get_u16(in, &loaded.sound_timer);
+    in = get_u32(in, &loaded.rng_state);
+    memcpy(loaded.audio_pattern, in, CHIP8_AUDIO_PATTERN_SIZE);
+    in += CHIP8_AUDIO_PATTERN_SIZE;
+    loaded.pitch = *in++;
+
+    uint8_t hires = *in++;
+    uint8_t planes = *in++;
+    memcpy(loaded.rpl, in, CHIP8_FLAG_REGISTER_COUNT);
+    in += CHIP8_FLAG_REGISTER_COUNT;
+    uint8_t quirks = *in++;
+    uint8_t vblank = *in++;
+
+    // The rest of the display is dark on this platform
+    memset(loaded.display, 0, sizeof(loaded.display));
+    size_t plane_count, rows, words;
+    display_extent(platform, &plane_count, &rows, &words);
+    for (size_t plane = 0; plane < plane_count; plane++)
+    {
+        for (size_t y = 0; y < rows; y++)
+        {
+            for (size_t word = 0; word < words; word++)
+            {
+                in = get_display_word(in, &loaded.display[plane][y][word]);
+            }
+        }
+    }
+
+    if (loaded.stack.stack_pointer > CHIP8_STACK_SIZE
+        || loaded.program_counter > memory_size - INSTRUCTION_SIZE
+        || loaded.rng_state == 0
+        || hires > (platform != CHIP8_PLATFORM_CHIP8)
+        || planes > (platform == CHIP8_PLATFORM_XOCHIP ? CHIP8_ALL_PLANES : 1)
+        || quirks >= CHIP8_QUIRK_COMBINATIONS
+        || vblank > 1)
+    {
+        fprintf(stderr, "Save state is corrupt\n");
+        return false;
+    }
+
+    loaded.platform = platform;
+    loaded.hires = hires;
+    loaded.planes = planes;
+    loaded.quirks = quirks;
+    loaded.vblank = vblank;
+    loaded.display_dirty = true;
+    chip8_copy(chip8, &loaded);
+    return true;
+}
+
+bool savestate_save_file(const Chip8 *chip8, const char *path)
+{
+    static uint8_t buffer[SAVESTATE_SIZE];
+    size_t size = savestate_write(chip8, buffer);
+
+    FILE *file = fopen(path, "wb");
+    if (file == NULL)
+    {
+        fprintf(stderr, "Could not open save state %s for writing\n", path);
+        return false;
+    }
+
+    bool ok = fwrite(buffer, 1, size, file) == size;
+    ok = (fclose(file) == 0) && ok;
+    if (!ok)
+        fprintf(stderr, "Could not write save state %s\n", path);
+    return ok;
+}
+
+bool savestate_load_file(Chip8 *chip8, const char *path)
+{
+    FILE *file = fopen(path, "rb");
+    if (file == NULL)
+    {
+        fprintf(stderr, "Could not open save state %s\n", path);
+        return false;
+    }
+
+    // Read one byte more than a valid state so oversized files get rejected
+    static uint8_t buffer[SAVESTATE_SIZE + 1];
+    size_t size = fread(buffer, 1, sizeof(buffer), file);
+    fclose(file);
+
+    return savestate_read(chip8, buffer, size);
+}
@@ -0,0 +1,43 @@
+#ifndef SAVESTATE_H
+#define SAVESTATE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "chip8.h"
+
+// Binary layout, all multi-byte fields little endian:
+//   "C8ST" magic, u16 version, u16 platform
+//   memory (4096 bytes, 65536 on XO-CHIP), V[16], u16 I, u16 stack[16], u8 stack_pointer,
+//   u16 program_counter, u16 delay_timer, u16 sound_timer, u32 rng_state,
+//   audio_pattern[16], u8 pitch, u8 hires, u8 planes, rpl[16], u8 quirks, u8 vblank,
+//   display packed 1 bit per pixel, MSB is the leftmost pixel: the 32 rows of 8 bytes
+//   of low resolution on CHIP-8, 64 rows of 16 bytes on SUPER-CHIP and both planes of
+//   64 rows of 16 bytes on XO-CHIP
+// Like memory, the display only takes the space the platform can use
+#define SAVESTATE_MAGIC "C8ST"
+#define SAVESTATE_VERSION (1U)
+#define SAVESTATE_HEADER_SIZE (8U)
+#define SAVESTATE_LORES_PLANE_SIZE (WIDTH * HEIGHT / 8)
+#define SAVESTATE_PLANE_SIZE (CHIP8_HIRES_WIDTH * CHIP8_HIRES_HEIGHT / 8)
+// Everything but memory and the display
+#define SAVESTATE_FIXED_SIZE (SAVESTATE_HEADER_SIZE + 16 + 2 + 2 * CHIP8_STACK_SIZE + 1 + 2 + 2 + 2 + 4 \
+                              + CHIP8_AUDIO_PATTERN_SIZE + 1 + 2 + CHIP8_FLAG_REGISTER_COUNT + 2)
+// XO-CHIP's, the largest
+#define SAVESTATE_SIZE (SAVESTATE_FIXED_SIZE + CHIP8_MEMORY_SIZE + CHIP8_PLANE_COUNT * SAVESTATE_PLANE_SIZE)
+
+// Number of bytes savestate_write produces for the machine, depends only on its platform
+size_t savestate_size(const Chip8 *chip8);
+
+// Serializes into buffer, which must hold savestate_size bytes, and returns the size written
+size_t savestate_write(const Chip8 *chip8, uint8_t *buffer);
+
+// Leaves chip8 untouched and returns false when the blob is not a valid save state.
+// The keypad is input rather than machine state, so it keeps its current value
+bool savestate_read(Chip8 *chip8, const uint8_t *buffer, size_t size);
+
+bool savestate_save_file(const Chip8 *chip8, const char *path);
+bool savestate_load_file(Chip8 *chip8, const char *path);
+
+#endif
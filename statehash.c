@@ -0,0 +1,131 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "statehash.h"
+
+uint64_t statehash_registers(const Registers *registers, uint16_t I, const Stack *stack,
+                             uint16_t program_counter, uint16_t delay_timer,
+                             uint16_t sound_timer, uint32_t rng_state)
+{
+    uint64_t words[2];
+    memcpy(words, registers->V, sizeof(words));
+
+    uint64_t hash = statehash_mix(words[0]);
+    hash = statehash_mix(hash ^ words[1]);
+    hash = statehash_mix(hash ^ ((uint64_t)I
+                                 | (uint64_t)program_counter << 16
+                                 | (uint64_t)delay_timer << 32
+                                 | (uint64_t)sound_timer << 48));
+    hash = statehash_mix(hash ^ ((uint64_t)rng_state | (uint64_t)stack->stack_pointer << 32));
+    for (size_t i = 0; i < CHIP8_STACK_SIZE; i += 4)
+    {
+        hash = statehash_mix(hash ^ ((uint64_t)stack->stack_arr[i]
+                                     | (uint64_t)stack->stack_arr[i + 1] << 16
+                                     | (uint64_t)stack->stack_arr[i + 2] << 32
+                                     | (uint64_t)stack->stack_arr[i + 3] << 48));
+    }
+    return hash;
+}
+
+uint64_t statehash_memory(const uint8_t *memory, size_t size)
+{
+    uint64_t hash = 0;
+    for (size_t address = 0; address < size; address++)
+    {
+        hash ^= statehash_memory_key(address, memory[address]);
+    }
+    return hash;
+}
+
+uint64_t statehash_extensions(bool hires, uint8_t planes, bool vblank, const uint8_t rpl[CHIP8_FLAG_REGISTER_COUNT],
+                              const uint8_t audio_pattern[CHIP8_AUDIO_PATTERN_SIZE], uint8_t pitch)
+{
+    uint64_t words[2];
+    uint64_t pattern[2];
+    memcpy(words, rpl, sizeof(words));
+    memcpy(pattern, audio_pattern, sizeof(pattern));
+    // Every byte of the power-on pattern is the same, so the byte order doesn't matter
+    uint64_t default_pattern = 0x0101010101010101ULL * CHIP8_DEFAULT_AUDIO_PATTERN_BYTE;
+    if (!hires && planes == 1 && !vblank && words[0] == 0 && words[1] == 0
+        && pattern[0] == default_pattern && pattern[1] == default_pattern && pitch == CHIP8_DEFAULT_PITCH)
+        return 0;
+
+    uint64_t hash = statehash_mix(STATEHASH_HIRES_BASE ^ hires ^ (uint64_t)planes << 8 ^ (uint64_t)vblank << 16
+                                  ^ (uint64_t)pitch << 24);
+    hash = statehash_mix(hash ^ words[0]);
+    hash = statehash_mix(hash ^ words[1]);
+    hash = statehash_mix(hash ^ pattern[0]);
+    return statehash_mix(hash ^ pattern[1]);
+}
+
+uint64_t statehash_display(const Chip8Display display)
+{
+    uint64_t hash = 0;
+    for (uint32_t plane = 0; plane < CHIP8_PLANE_COUNT; plane++)
+    {
+        for (uint32_t y = 0; y < CHIP8_HIRES_HEIGHT; y++)
+        {
+            for (uint32_t word = 0; word < CHIP8_DISPLAY_WORDS; word++)
+            {
+                hash ^= statehash_row_key(plane, y, word, display[plane][y][word]);
+            }
+        }
+    }
+    return hash;
+}
+
+void chip8_hash_rebuild(Chip8 *chip8)
+{
+    chip8->memory_hash = statehash_memory(CHIP8_MEMORY(chip8), chip8_memory_size(chip8));
+    chip8->display_hash = statehash_display(chip8->display);
+}
+
+uint64_t chip8_hash(const Chip8 *chip8)
+{
+    return chip8->memory_hash ^ chip8->display_hash
+           ^ statehash_registers(&chip8->registers, chip8->I, &chip8->stack, chip8->program_counter,
+                                 chip8->delay_timer, chip8->sound_timer, chip8->rng_state)
+           ^ statehash_extensions(chip8->hires, chip8->planes, chip8->vblank, chip8->rpl,
+                                  chip8->audio_pattern, chip8->pitch);
+}
+
+uint64_t chip8_hash_full(const Chip8 *chip8)
+{
+    return statehash_memory(CHIP8_MEMORY(chip8), chip8_memory_size(chip8)) ^ statehash_display(chip8->display)
+           ^ statehash_registers(&chip8->registers, chip8->I, &chip8->stack, chip8->program_counter,
+                                 chip8->delay_timer, chip8->sound_timer, chip8->rng_state)
+           ^ statehash_extensions(chip8->hires, chip8->planes, chip8->vblank, chip8->rpl,
+                                  chip8->audio_pattern, chip8->pitch);
+}
+
+static inline void hashed_memory_write(Chip8 *chip8, uint16_t address, uint8_t value)
+{
+    address &= chip8->address_mask;
+    chip8->memory_hash ^= statehash_memory_key(address, CHIP8_MEMORY(chip8)[address])
+                          ^ statehash_memory_key(address, value);
+    CHIP8_MEMORY(chip8)[address] = value;
+}
+
+#define CHIP8_EXECUTE execute_instruction_hashed
+#define CHIP8_MACHINE Chip8
+#define MEM_READ(m, addr) (CHIP8_MEMORY(m)[(addr) & (m)->address_mask])
+#define MEM_WRITE(m, addr, value) hashed_memory_write((m), (addr), (value))
+#define DISPLAY(m) ((m)->display)
+#define DISPLAY_WRITE_BEGIN(m)
+#define ROW_FLIPPED(m, plane, y, word, mask) ((m)->display_hash ^= statehash_row_key((plane), (y), (word), (mask)))
+#define CHIP8_SPECIALIZE_QUIRKS
+#include "chip8_execute.inc"
+
+Chip8Status chip8_step_hashed(Chip8 *chip8)
+{
+    Chip8Status status = execute_instruction_hashed(chip8, chip8_fetch(chip8));
+
+#ifdef CHIP8_HASH_CHECK
+    if (chip8_hash(chip8) != chip8_hash_full(chip8))
+    {
+        fprintf(stderr, "ERROR: rolling hash diverged after PC=0x%04x\n", chip8->program_counter);
+        exit(1);
+    }
+#endif
+    return status;
+}
@@ -0,0 +1,92 @@
+#ifndef STATEHASH_H
+#define STATEHASH_H
+
+#include <stdint.h>
+
+#include "chip8.h"
+
+// Zobrist-style state hash. Every memory byte and every lit pixel contributes a
+// pseudo random key derived from its position (and value), the contributions are
+// XORed together so a single write updates the hash in O(1):
+//
+//   memory_hash ^= key(addr, old) ^ key(addr, new)
+//   display_hash ^= key(pixel)     for every pixel that changes
+//
+// Draws, clears and scrolls alike only touch the keys of the pixels they flip, a
+// clear of a full screen or a scroll of a busy one still visits each of them
+//
+// The register file is small enough that it is mixed in fresh on every query.
+// Build with -DCHIP8_HASH_CHECK to compare the rolling hash against a full
+// rehash after every hashed instruction
+
+// Where the low resolution pixel keys start, right after the 4 KB of classic memory
+#define STATEHASH_DISPLAY_BASE (CHIP8_CLASSIC_MEMORY_SIZE)
+// Pixels outside the low resolution screen, clear of every memory and low resolution key
+#define STATEHASH_HIRES_BASE (1ULL << 32)
+// XO-CHIP plane 1, and memory past the first 4 KB
+#define STATEHASH_PLANE_BASE (2ULL << 32)
+#define STATEHASH_HIGH_MEMORY (1ULL << 40)
+
+// splitmix64 finalizer
+static inline uint64_t statehash_mix(uint64_t x)
+{
+    x += 0x9E3779B97F4A7C15ULL;
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+    return x ^ (x >> 31);
+}
+
+static inline uint64_t statehash_memory_key(uint16_t address, uint8_t value)
+{
+    // Classic addresses keep their keys, the rest would overlap the display's
+    return statehash_mix(((uint64_t)address << 8) | value
+                         | (uint64_t)(address >= CHIP8_CLASSIC_MEMORY_SIZE) * STATEHASH_HIGH_MEMORY);
+}
+
+static inline uint64_t statehash_pixel_key(uint32_t plane, uint32_t x, uint32_t y)
+{
+    // Plane 0's low resolution pixels keep the keys they had before high resolution
+    // and planes existed, so hashes recorded from plain CHIP-8 runs stay valid
+    if (plane != 0)
+        return statehash_mix(STATEHASH_PLANE_BASE | (y * CHIP8_HIRES_WIDTH + x));
+    if (x < WIDTH && y < HEIGHT)
+        return statehash_mix((uint64_t)(STATEHASH_DISPLAY_BASE + x * HEIGHT + y) << 8);
+    return statehash_mix(STATEHASH_HIRES_BASE | (y * CHIP8_HIRES_WIDTH + x));
+}
+
+// XOR of the keys of every pixel set in mask, for DISPLAY(m)[plane][y][word] ^= mask
+static inline uint64_t statehash_row_key(uint32_t plane, uint32_t y, uint32_t word, uint64_t mask)
+{
+    uint64_t key = 0;
+    for (; mask != 0; mask &= mask - 1)
+    {
+        key ^= statehash_pixel_key(plane, word * 64 + 63 - __builtin_ctzll(mask), y);
+    }
+    return key;
+}
+
+uint64_t statehash_registers(const Registers *registers, uint16_t I, const Stack *stack,
+                             uint16_t program_counter, uint16_t delay_timer,
+                             uint16_t sound_timer, uint32_t rng_state);
+// SUPER-CHIP, XO-CHIP (planes, audio pattern and pitch) and display wait state, 0 while
+// it is all at power-on values so plain CHIP-8 hashes don't change
+uint64_t statehash_extensions(bool hires, uint8_t planes, bool vblank, const uint8_t rpl[CHIP8_FLAG_REGISTER_COUNT],
+                              const uint8_t audio_pattern[CHIP8_AUDIO_PATTERN_SIZE], uint8_t pitch);
+// Hashes the first size bytes, the platform's whole memory
+uint64_t statehash_memory(const uint8_t *memory, size_t size);
+uint64_t statehash_display(const Chip8Display display);
+
+// Recomputes memory_hash and display_hash from scratch, needed after anything
+// outside the hashed interpreter (set_rom, save state loads, ...) touched the machine
+void chip8_hash_rebuild(Chip8 *chip8);
+
+// O(1), valid while the machine is only advanced with chip8_step_hashed
+uint64_t chip8_hash(const Chip8 *chip8);
+
+// Full rehash of all the state, up to ~70 KB on XO-CHIP
+uint64_t chip8_hash_full(const Chip8 *chip8);
+
+Chip8Status execute_instruction_hashed(Chip8 *chip8, uint16_t opcode);
+Chip8Status chip8_step_hashed(Chip8 *chip8);
+
+#endif
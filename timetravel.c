@@ -0,0 +1,274 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "debugger.h"
+#include "timetravel.h"
+
+typedef struct
+{
+    uint64_t position;
+    uint16_t keypad;
+    // Timers count down after the keypad is applied, like at the start of a frame
+    bool tick;
+} TimeEvent;
+
+typedef struct
+{
+    Chip8 machine;
+    uint64_t position;
+    // First event that happened at or after position
+    uint64_t event;
+} Checkpoint;
+
+// Both rings are indexed by absolute counters, entry n lives at n % capacity
+static Checkpoint *checkpoints;
+static size_t checkpoint_capacity;
+static uint64_t checkpoint_first;
+static uint64_t checkpoint_end;
+
+static TimeEvent *events;
+static size_t event_capacity;
+static uint64_t event_first;
+static uint64_t event_end;
+
+static uint32_t checkpoint_interval;
+static uint64_t position;
+static uint16_t recorded_keypad;
+
+// Machine timetravel_continue_back scans on, kept so its XO-CHIP memory is reused
+static Chip8 scratch;
+
+static Checkpoint *checkpoint_at(uint64_t index)
+{
+    return &checkpoints[index % checkpoint_capacity];
+}
+
+static TimeEvent *event_at(uint64_t index)
+{
+    return &events[index % event_capacity];
+}
+
+bool timetravel_init(size_t capacity, uint32_t interval, const Chip8 *chip8)
+{
+    // A quarter of the budget goes to the event log, about one event per frame. XO-CHIP
+    // checkpoints also carry the machine's separately allocated memory
+    size_t checkpoint_size = sizeof(Checkpoint);
+    if (chip8->extended_memory != NULL)
+        checkpoint_size += CHIP8_MEMORY_SIZE;
+    checkpoint_capacity = capacity * 3 / 4 / checkpoint_size;
+    event_capacity = capacity / 4 / sizeof(TimeEvent);
+    if (checkpoint_capacity < 2 || event_capacity < 2 || interval == 0)
+    {
+        fprintf(stderr, "Time travel needs more than %zu bytes and a non-zero interval\n", capacity);
+        return false;
+    }
+
+    // Zeroed, so the first snapshot into each checkpoint finds no memory block to reuse
+    checkpoints = calloc(checkpoint_capacity, sizeof(Checkpoint));
+    events = malloc(event_capacity * sizeof(TimeEvent));
+    if (checkpoints == NULL || events == NULL)
+    {
+        fprintf(stderr, "Could not allocate %zu bytes of time travel history\n", capacity);
+        timetravel_free();
+        return false;
+    }
+
+    checkpoint_interval = interval;
+    checkpoint_first = checkpoint_end = 0;
+    event_first = event_end = 0;
+    position = 0;
+    return true;
+}
+
+void timetravel_free(void)
+{
+    for (size_t i = 0; checkpoints != NULL && i < checkpoint_capacity; i++)
+    {
+        chip8_free(&checkpoints[i].machine);
+    }
+    chip8_free(&scratch);
+    free(checkpoints);
+    free(events);
+    checkpoints = NULL;
+    events = NULL;
+}
+
+static void drop_oldest_checkpoint(void)
+{
+    checkpoint_first++;
+    event_first = checkpoint_at(checkpoint_first)->event;
+}
+
+static void add_checkpoint(const Chip8 *chip8)
+{
+    if (checkpoint_end - checkpoint_first == checkpoint_capacity)
+        drop_oldest_checkpoint();
+
+    Checkpoint *checkpoint = checkpoint_at(checkpoint_end++);
+    chip8_snapshot(chip8, &checkpoint->machine);
+    checkpoint->position = position;
+    checkpoint->event = event_end;
+}
+
+static void log_event(const Chip8 *chip8, bool tick)
+{
+    while (event_end - event_first == event_capacity)
+    {
+        // The oldest checkpoint is the only one left using the oldest events, so it goes.
+        // With a single checkpoint left a fresh one takes its place first
+        if (checkpoint_end - checkpoint_first == 1)
+            add_checkpoint(chip8);
+        drop_oldest_checkpoint();
+    }
+
+    TimeEvent *event = event_at(event_end++);
+    event->position = position;
+    event->keypad = chip8->keypad;
+    event->tick = tick;
+    recorded_keypad = chip8->keypad;
+}
+
+void timetravel_reset(const Chip8 *chip8)
+{
+    if (checkpoints == NULL)
+        return;
+
+    checkpoint_first = checkpoint_end = 0;
+    event_first = event_end = 0;
+    position = 0;
+    recorded_keypad = chip8->keypad;
+    add_checkpoint(chip8);
+}
+
+void timetravel_frame(const Chip8 *chip8)
+{
+    if (checkpoints == NULL)
+        return;
+
+    if (checkpoint_end == checkpoint_first
+        || position - checkpoint_at(checkpoint_end - 1)->position >= checkpoint_interval)
+        add_checkpoint(chip8);
+    log_event(chip8, true);
+}
+
+void timetravel_input(const Chip8 *chip8)
+{
+    if (checkpoints != NULL && chip8->keypad != recorded_keypad)
+        log_event(chip8, false);
+}
+
+void timetravel_advance(uint64_t instructions)
+{
+    position += instructions;
+}
+
+uint64_t timetravel_position(void)
+{
+    return position;
+}
+
+bool timetravel_frame_progress(uint32_t *instructions)
+{
+    if (checkpoints == NULL)
+        return false;
+
+    for (uint64_t index = event_end; index > event_first; index--)
+    {
+        const TimeEvent *event = event_at(index - 1);
+        if (event->tick)
+        {
+            *instructions = position - event->position;
+            return true;
+        }
+    }
+    return false;
+}
+
+// Newest checkpoint at or before target
+static uint64_t checkpoint_before(uint64_t target)
+{
+    uint64_t index = checkpoint_end - 1;
+    while (index > checkpoint_first && checkpoint_at(index)->position > target)
+        index--;
+    return index;
+}
+
+// Re-executes from a checkpoint up to target, applying the logged events on the way.
+// When last_stop is not NULL it gets the last position before target where
+// debugger_would_stop was true, or stays untouched if there was none
+static void replay(Chip8 *chip8, uint64_t checkpoint_index, uint64_t target, uint64_t *last_stop)
+{
+    const Checkpoint *checkpoint = checkpoint_at(checkpoint_index);
+    chip8_restore(chip8, &checkpoint->machine);
+
+    uint64_t event = checkpoint->event;
+    for (uint64_t at = checkpoint->position;; at++)
+    {
+        while (event < event_end && event_at(event)->position == at)
+        {
+            chip8->keypad = event_at(event)->keypad;
+            if (event_at(event)->tick)
+                chip8_tick_timers(chip8);
+            event++;
+        }
+        if (at == target)
+            break;
+
+        if (last_stop != NULL && debugger_would_stop(chip8))
+            *last_stop = at;
+        // The recorded run never trapped, it would have ended there
+        chip8_step(chip8);
+    }
+}
+
+// Makes target the present, the history after it no longer happened
+static void truncate_history(const Chip8 *chip8, uint64_t target)
+{
+    while (checkpoint_end - checkpoint_first > 1 && checkpoint_at(checkpoint_end - 1)->position > target)
+        checkpoint_end--;
+    while (event_end > event_first && event_at(event_end - 1)->position > target)
+        event_end--;
+
+    position = target;
+    recorded_keypad = chip8->keypad;
+}
+
+bool timetravel_step_back(Chip8 *chip8)
+{
+    if (checkpoints == NULL || checkpoint_end == checkpoint_first
+        || position == checkpoint_at(checkpoint_first)->position)
+        return false;
+
+    uint64_t target = position - 1;
+    replay(chip8, checkpoint_before(target), target, NULL);
+    truncate_history(chip8, target);
+    return true;
+}
+
+bool timetravel_continue_back(Chip8 *chip8)
+{
+    if (checkpoints == NULL || checkpoint_end == checkpoint_first)
+        return false;
+
+    // Scan one checkpoint interval at a time, newest first, on a scratch machine
+    uint64_t end = position;
+    for (uint64_t index = checkpoint_before(position);; index--)
+    {
+        uint64_t start = checkpoint_at(index)->position;
+        if (start < end)
+        {
+            uint64_t stop = end;
+            replay(&scratch, index, end, &stop);
+            if (stop != end)
+            {
+                replay(chip8, index, stop, NULL);
+                truncate_history(chip8, stop);
+                return true;
+            }
+            end = start;
+        }
+        if (index == checkpoint_first)
+            return false;
+    }
+}
@@ -0,0 +1,53 @@
+#ifndef TIMETRAVEL_H
+#define TIMETRAVEL_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "chip8.h"
+
+// Instruction-level history for the debugger. Every interval instructions the
+// whole machine is copied into a checkpoint, and everything that changes it from
+// outside the interpreter (timer ticks and keypad changes) is logged with the
+// instruction position it happened at. Any earlier position is rebuilt by
+// restoring the nearest checkpoint before it and re-executing, CXNN draws from
+// the seeded generator inside the machine so the re-run takes the same path.
+//
+// Going back one instruction costs at most interval instructions of re-execution.
+// Checkpoints and the event log share capacity bytes, the oldest checkpoint and
+// the events only it needed are dropped when it runs out
+
+#define TIMETRAVEL_DEFAULT_CAPACITY (16U * 1024 * 1024)
+#define TIMETRAVEL_DEFAULT_INTERVAL (10000U)
+
+// Checkpoints are sized for the memory of chip8's platform
+bool timetravel_init(size_t capacity, uint32_t interval, const Chip8 *chip8);
+void timetravel_free(void);
+
+// Forgets all history and starts over at the machine as it is now, needed after
+// anything that moves the machine other than running it (loading a state, rewinding)
+void timetravel_reset(const Chip8 *chip8);
+
+// Call at the start of each emulated frame, before its timers tick
+void timetravel_frame(const Chip8 *chip8);
+// Call after a keypad change inside a frame so it gets logged
+void timetravel_input(const Chip8 *chip8);
+// Call with the number of instructions that actually executed
+void timetravel_advance(uint64_t instructions);
+
+// Number of instructions executed since the history started
+uint64_t timetravel_position(void);
+// Number of instructions executed since the newest frame started, false when the
+// history holds no frame start
+bool timetravel_frame_progress(uint32_t *instructions);
+
+// Moves the machine back one instruction, false at the start of the history
+bool timetravel_step_back(Chip8 *chip8);
+
+// Moves the machine back to the most recent instruction that would have stopped
+// chip8_step_debug (a breakpoint, or an access to a watched address). The machine
+// ends up just before that instruction, false if the history holds no such point
+bool timetravel_continue_back(Chip8 *chip8);
+
+#endif
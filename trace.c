@@ -0,0 +1,111 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "host_time.h"
+#include "trace.h"
+
+typedef struct
+{
+    uint64_t start_ns;
+    uint32_t duration_ns;
+    uint8_t phase;
+} TraceEvent;
+
+static const char *trace_phase_names[TRACE_PHASE_COUNT] = {
+    [TRACE_FRAME] = "frame",
+    [TRACE_GET_INPUT] = "get_input",
+    [TRACE_EMULATION] = "emulation",
+    [TRACE_RUN_AHEAD] = "run_ahead",
+    [TRACE_DRAW] = "draw",
+    [TRACE_END_DRAWING] = "EndDrawing",
+    [TRACE_AUDIO] = "audio",
+};
+
+bool trace_enabled = false;
+
+static FILE *trace_file;
+static TraceEvent *trace_events;
+static size_t trace_capacity;
+static size_t trace_count;
+static size_t trace_head;
+static uint64_t trace_origin_ns;
+static uint64_t trace_phase_start_ns[TRACE_PHASE_COUNT];
+
+bool trace_open(const char *path, size_t capacity)
+{
+    trace_file = fopen(path, "w");
+    if (trace_file == NULL)
+    {
+        fprintf(stderr, "Could not open trace file %s\n", path);
+        return false;
+    }
+
+    trace_events = calloc(capacity, sizeof(TraceEvent));
+    if (trace_events == NULL)
+    {
+        fprintf(stderr, "Could not allocate %zu trace events\n", capacity);
+        fclose(trace_file);
+        trace_file = NULL;
+        return false;
+    }
+
+    trace_capacity = capacity;
+    trace_count = 0;
+    trace_head = 0;
+    trace_origin_ns = host_time_ns();
+    trace_enabled = true;
+    return true;
+}
+
+void trace_begin(TracePhase phase)
+{
+    if (!trace_enabled)
+        return;
+
+    trace_phase_start_ns[phase] = host_time_ns();
+}
+
+void trace_end(TracePhase phase)
+{
+    if (!trace_enabled)
+        return;
+
+    uint64_t end_ns = host_time_ns();
+    TraceEvent *event = &trace_events[trace_head];
+    event->start_ns = trace_phase_start_ns[phase];
+    event->duration_ns = (uint32_t)(end_ns - trace_phase_start_ns[phase]);
+    event->phase = phase;
+
+    trace_head = (trace_head + 1) % trace_capacity;
+    if (trace_count < trace_capacity)
+        trace_count++;
+}
+
+void trace_close(void)
+{
+    if (!trace_enabled)
+        return;
+
+    fprintf(trace_file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    fprintf(trace_file, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":1,\"args\":{\"name\":\"chip8\"}}");
+
+    // Oldest retained event sits at the head once the ring has wrapped
+    size_t first = (trace_count == trace_capacity) ? trace_head : 0;
+    for (size_t i = 0; i < trace_count; i++)
+    {
+        const TraceEvent *event = &trace_events[(first + i) % trace_capacity];
+        fprintf(trace_file,
+                ",\n{\"name\":\"%s\",\"cat\":\"frame\",\"ph\":\"X\",\"pid\":1,\"tid\":1,\"ts\":%.3f,\"dur\":%.3f}",
+                trace_phase_names[event->phase],
+                (event->start_ns - trace_origin_ns) / 1000.0,
+                event->duration_ns / 1000.0);
+    }
+    fprintf(trace_file, "\n]}\n");
+
+    fclose(trace_file);
+    free(trace_events);
+    trace_file = NULL;
+    trace_events = NULL;
+    trace_enabled = false;
+}
@@ -0,0 +1,33 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+// Per-frame phase timeline, written out as Chrome trace-event JSON
+// (chrome://tracing or ui.perfetto.dev)
+
+#define TRACE_DEFAULT_CAPACITY (1U << 16)
+
+typedef enum
+{
+    TRACE_FRAME,
+    TRACE_GET_INPUT,
+    TRACE_EMULATION,
+    TRACE_RUN_AHEAD,
+    TRACE_DRAW,
+    TRACE_END_DRAWING,
+    TRACE_AUDIO,
+    TRACE_PHASE_COUNT,
+} TracePhase;
+
+extern bool trace_enabled;
+
+// Events live in a fixed ring of `capacity` entries, once it is full the
+// oldest events are overwritten. Nothing is written until trace_close
+bool trace_open(const char *path, size_t capacity);
+void trace_begin(TracePhase phase);
+void trace_end(TracePhase phase);
+void trace_close(void);
+
+#endif
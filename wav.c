@@ -0,0 +1,89 @@
+#include <string.h>
+
+#include "wav.h"
+
+#define WAV_HEADER_SIZE (44U)
+
+static uint8_t *put_u16(uint8_t *out, uint16_t value)
+{
+    out[0] = value & 0xFF;
+    out[1] = value >> 8;
+    return out + 2;
+}
+
+static uint8_t *put_u32(uint8_t *out, uint32_t value)
+{
+    out = put_u16(out, value & 0xFFFF);
+    return put_u16(out, value >> 16);
+}
+
+static void wav_header(uint8_t *out, uint32_t sample_rate, uint32_t data_size)
+{
+    memcpy(out, "RIFF", 4);
+    out = put_u32(out + 4, WAV_HEADER_SIZE - 8 + data_size);
+    memcpy(out, "WAVEfmt ", 8);
+    out = put_u32(out + 8, 16);
+    out = put_u16(out, 1); // PCM
+    out = put_u16(out, 1); // mono
+    out = put_u32(out, sample_rate);
+    out = put_u32(out, sample_rate * 2);
+    out = put_u16(out, 2);
+    out = put_u16(out, 16);
+    memcpy(out, "data", 4);
+    put_u32(out + 4, data_size);
+}
+
+bool wav_open(WavWriter *wav, const char *path, uint32_t sample_rate)
+{
+    wav->file = fopen(path, "wb");
+    wav->sample_rate = sample_rate;
+    wav->frames = 0;
+    if (wav->file == NULL)
+    {
+        fprintf(stderr, "Could not create %s\n", path);
+        return false;
+    }
+
+    // Placeholder sizes until wav_close knows them
+    uint8_t header[WAV_HEADER_SIZE];
+    wav_header(header, sample_rate, 0);
+    return fwrite(header, 1, sizeof(header), wav->file) == sizeof(header);
+}
+
+bool wav_write(WavWriter *wav, const int16_t *samples, size_t frames)
+{
+    uint8_t buffer[512];
+    size_t done = 0;
+    while (done < frames)
+    {
+        size_t chunk = frames - done < sizeof(buffer) / 2 ? frames - done : sizeof(buffer) / 2;
+        for (size_t i = 0; i < chunk; i++)
+        {
+            put_u16(buffer + 2 * i, (uint16_t)samples[done + i]);
+        }
+        if (fwrite(buffer, 2, chunk, wav->file) != chunk)
+            return false;
+        done += chunk;
+    }
+    wav->frames += frames;
+    return true;
+}
+
+bool wav_close(WavWriter *wav)
+{
+    if (wav->file == NULL)
+        return false;
+
+    // RIFF sizes are 32 bit, about 13 hours at 44.1 kHz
+    uint64_t data_size = wav->frames * 2;
+    if (data_size > UINT32_MAX - WAV_HEADER_SIZE)
+        data_size = UINT32_MAX - WAV_HEADER_SIZE;
+
+    uint8_t header[WAV_HEADER_SIZE];
+    wav_header(header, wav->sample_rate, (uint32_t)data_size);
+    bool ok = fseek(wav->file, 0, SEEK_SET) == 0
+              && fwrite(header, 1, sizeof(header), wav->file) == sizeof(header);
+    ok = fclose(wav->file) == 0 && ok;
+    wav->file = NULL;
+    return ok;
+}
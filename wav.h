@@ -0,0 +1,23 @@
+#ifndef WAV_H
+#define WAV_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+// Streams 16 bit mono PCM into a RIFF/WAVE file. The header's sizes are only
+// known at the end, wav_close goes back and fills them in
+
+typedef struct
+{
+    FILE *file;
+    uint32_t sample_rate;
+    uint64_t frames;
+} WavWriter;
+
+bool wav_open(WavWriter *wav, const char *path, uint32_t sample_rate);
+bool wav_write(WavWriter *wav, const int16_t *samples, size_t frames);
+bool wav_close(WavWriter *wav);
+
+#endif